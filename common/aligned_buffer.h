@@ -0,0 +1,180 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// Alignment of every buffer: one cache line, enough for aligned AVX-512 loads
+const std::size_t BUFFER_ALIGNMENT = 64;
+const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+enum class page_mode
+{
+    normal,
+    // 2 MiB aligned and advised to the kernel as huge-page backed (Linux THP); normal pages elsewhere
+    transparent_huge,
+    // Explicit 2 MiB pages (Linux hugetlbfs pool, Windows large pages); falls back to transparent_huge
+    explicit_huge
+};
+
+inline const char* page_mode_name(page_mode mode)
+{
+    switch (mode)
+    {
+    case page_mode::transparent_huge: return "transparent huge pages";
+    case page_mode::explicit_huge: return "explicit huge pages";
+    default: return "4 KiB pages";
+    }
+}
+
+// Every block starts with this header, BUFFER_ALIGNMENT bytes before the returned pointer,
+// so release_buffer knows which path actually provided the memory
+struct buffer_header
+{
+    void* base;
+    std::size_t bytes;
+    page_mode mode;
+};
+
+inline void* finish_buffer(void* base, std::size_t bytes, page_mode mode)
+{
+    buffer_header* header = static_cast<buffer_header*>(base);
+    header->base = base;
+    header->bytes = bytes;
+    header->mode = mode;
+    return static_cast<char*>(base) + BUFFER_ALIGNMENT;
+}
+
+inline void* allocate_buffer(std::size_t bytes, page_mode mode)
+{
+    std::size_t total = bytes + BUFFER_ALIGNMENT;
+    if (mode == page_mode::explicit_huge)
+    {
+        std::size_t rounded = (total + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+#ifdef _WIN32
+        void* base = VirtualAlloc(nullptr, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+#else
+        void* base = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base == MAP_FAILED)
+        {
+            base = nullptr;
+        }
+#endif
+        if (base)
+        {
+            return finish_buffer(base, rounded, page_mode::explicit_huge);
+        }
+        mode = page_mode::transparent_huge;
+    }
+
+#ifndef _WIN32
+    if (mode == page_mode::transparent_huge)
+    {
+        std::size_t rounded = (total + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        void* base = nullptr;
+        if (posix_memalign(&base, HUGE_PAGE_SIZE, rounded) != 0)
+        {
+            throw std::bad_alloc();
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(base, rounded, MADV_HUGEPAGE);
+#endif
+        return finish_buffer(base, rounded, page_mode::transparent_huge);
+    }
+#endif
+
+#ifdef _WIN32
+    void* base = _aligned_malloc(total, BUFFER_ALIGNMENT);
+#else
+    void* base = nullptr;
+    if (posix_memalign(&base, BUFFER_ALIGNMENT, total) != 0)
+    {
+        base = nullptr;
+    }
+#endif
+    if (!base)
+    {
+        throw std::bad_alloc();
+    }
+    return finish_buffer(base, total, page_mode::normal);
+}
+
+inline void release_buffer(void* pointer)
+{
+    if (!pointer)
+    {
+        return;
+    }
+    const buffer_header* header = reinterpret_cast<const buffer_header*>(static_cast<char*>(pointer) - BUFFER_ALIGNMENT);
+    void* base = header->base;
+    if (header->mode == page_mode::explicit_huge)
+    {
+#ifdef _WIN32
+        VirtualFree(base, 0, MEM_RELEASE);
+#else
+        munmap(base, header->bytes);
+#endif
+        return;
+    }
+#ifdef _WIN32
+    _aligned_free(base);
+#else
+    std::free(base);
+#endif
+}
+
+// Page mode the buffer at pointer really got, after any fallback
+inline page_mode buffer_page_mode(const void* pointer)
+{
+    return reinterpret_cast<const buffer_header*>(static_cast<const char*>(pointer) - BUFFER_ALIGNMENT)->mode;
+}
+
+// Standard allocator over allocate_buffer; the requested page mode travels with the allocator
+template <class T>
+struct aligned_allocator
+{
+    typedef T value_type;
+
+    page_mode mode;
+
+    aligned_allocator(page_mode mode = page_mode::normal) : mode(mode) {}
+
+    template <class U>
+    aligned_allocator(const aligned_allocator<U>& other) : mode(other.mode) {}
+
+    T* allocate(std::size_t count)
+    {
+        return static_cast<T*>(allocate_buffer(count * sizeof(T), mode));
+    }
+
+    void deallocate(T* pointer, std::size_t)
+    {
+        release_buffer(pointer);
+    }
+};
+
+template <class T, class U>
+bool operator==(const aligned_allocator<T>& a, const aligned_allocator<U>& b)
+{
+    return a.mode == b.mode;
+}
+
+template <class T, class U>
+bool operator!=(const aligned_allocator<T>& a, const aligned_allocator<U>& b)
+{
+    return a.mode != b.mode;
+}
+
+template <class T>
+using aligned_vector = std::vector<T, aligned_allocator<T>>;
@@ -0,0 +1,142 @@
+#pragma once
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// GCC and Clang only emit vector instructions inside functions that enable them; MSVC always can
+#if defined(__GNUC__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#define TARGET_AVX512IFMA __attribute__((target("avx512f,avx512ifma,avx2,fma")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#define TARGET_AVX512
+#define TARGET_AVX512IFMA
+#endif
+
+enum class simd_level
+{
+    scalar,
+    sse2,
+    avx2,
+    avx512
+};
+
+inline const char* simd_level_name(simd_level level)
+{
+    switch (level)
+    {
+    case simd_level::sse2: return "SSE2";
+    case simd_level::avx2: return "AVX2";
+    case simd_level::avx512: return "AVX-512";
+    default: return "scalar";
+    }
+}
+
+inline void cpuid(unsigned leaf, unsigned subleaf, unsigned registers[4])
+{
+#ifdef _MSC_VER
+    int values[4];
+    __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; ++i)
+    {
+        registers[i] = static_cast<unsigned>(values[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+// Register state the OS saves on context switches (XCR0)
+inline unsigned long long enabled_register_state()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned eax, edx;
+    __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+// Widest level supported by the CPU and enabled by the OS. AVX2 is only reported together
+// with FMA, since the AVX2 kernels use both.
+inline simd_level detect_simd_level()
+{
+    unsigned leaf0[4], leaf1[4], leaf7[4] = { 0, 0, 0, 0 };
+    cpuid(0, 0, leaf0);
+    cpuid(1, 0, leaf1);
+    if (leaf0[0] >= 7)
+    {
+        cpuid(7, 0, leaf7);
+    }
+
+    bool sse2 = (leaf1[3] >> 26) & 1;
+    bool osxsave = (leaf1[2] >> 27) & 1;
+    bool fma = (leaf1[2] >> 12) & 1;
+    bool avx2 = (leaf7[1] >> 5) & 1;
+    bool avx512f = (leaf7[1] >> 16) & 1;
+    unsigned long long xcr0 = osxsave ? enabled_register_state() : 0;
+    bool ymm_enabled = (xcr0 & 0x6) == 0x6;
+    bool zmm_enabled = (xcr0 & 0xE6) == 0xE6;
+
+    if (avx512f && avx2 && fma && zmm_enabled)
+    {
+        return simd_level::avx512;
+    }
+    if (avx2 && fma && ymm_enabled)
+    {
+        return simd_level::avx2;
+    }
+    return sse2 ? simd_level::sse2 : simd_level::scalar;
+}
+
+// 52-bit integer multiply-add (AVX512_IFMA), only reported when the AVX-512 level is available
+inline bool detect_avx512_ifma()
+{
+    if (detect_simd_level() != simd_level::avx512)
+    {
+        return false;
+    }
+    unsigned leaf7[4];
+    cpuid(7, 0, leaf7);
+    return (leaf7[1] >> 21) & 1;
+}
+
+// Level the kernels are bound to: the detected one, lowered by the SIMD_LEVEL environment
+// variable (scalar, sse2, avx2, avx512) when set, so one machine can run every variant
+inline simd_level selected_simd_level()
+{
+    simd_level detected = detect_simd_level();
+    const char* requested = std::getenv("SIMD_LEVEL");
+    if (!requested)
+    {
+        return detected;
+    }
+
+    simd_level level = detected;
+    if (std::strcmp(requested, "scalar") == 0)
+    {
+        level = simd_level::scalar;
+    }
+    else if (std::strcmp(requested, "sse2") == 0)
+    {
+        level = simd_level::sse2;
+    }
+    else if (std::strcmp(requested, "avx2") == 0)
+    {
+        level = simd_level::avx2;
+    }
+    else if (std::strcmp(requested, "avx512") == 0)
+    {
+        level = simd_level::avx512;
+    }
+    return level < detected ? level : detected;
+}
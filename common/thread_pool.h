@@ -0,0 +1,220 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+// Barrier for a fixed team that can be passed any number of times: the last thread to arrive opens the next
+// generation, the others spin on it for a while and then yield
+class spin_barrier
+{
+public:
+    void reset(unsigned count)
+    {
+        team = count;
+        arrived.store(0, std::memory_order_relaxed);
+    }
+
+    void arrive_and_wait()
+    {
+        unsigned current = generation.load(std::memory_order_acquire);
+        if (arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == team)
+        {
+            arrived.store(0, std::memory_order_relaxed);
+            generation.store(current + 1, std::memory_order_release);
+            return;
+        }
+        for (unsigned spins = 0; generation.load(std::memory_order_acquire) == current; ++spins)
+        {
+            if (spins >= SPIN_LIMIT)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    static constexpr unsigned SPIN_LIMIT = 4096;
+    unsigned team = 1;
+    std::atomic<unsigned> arrived{ 0 };
+    std::atomic<unsigned> generation{ 0 };
+};
+
+// Pins the calling thread to the n-th CPU (modulo their count) the process may run on; a no-op where unsupported
+inline void pin_current_thread(unsigned n)
+{
+#if defined(__linux__)
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0)
+    {
+        return;
+    }
+    unsigned target = n % static_cast<unsigned>(CPU_COUNT(&allowed));
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &allowed) && target-- == 0)
+        {
+            cpu_set_t single;
+            CPU_ZERO(&single);
+            CPU_SET(cpu, &single);
+            pthread_setaffinity_np(pthread_self(), sizeof(single), &single);
+            return;
+        }
+    }
+#elif defined(_WIN32)
+    DWORD_PTR allowed = 0, system = 0;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &allowed, &system) || allowed == 0)
+    {
+        return;
+    }
+    unsigned count = 0;
+    for (DWORD_PTR bits = allowed; bits; bits &= bits - 1)
+    {
+        ++count;
+    }
+    unsigned target = n % count;
+    for (unsigned cpu = 0; cpu < sizeof(DWORD_PTR) * 8; ++cpu)
+    {
+        DWORD_PTR single = static_cast<DWORD_PTR>(1) << cpu;
+        if ((allowed & single) && target-- == 0)
+        {
+            SetThreadAffinityMask(GetCurrentThread(), single);
+            return;
+        }
+    }
+#else
+    (void)n;
+#endif
+}
+
+// Fork-join over workers that persist across calls. run(count, body) calls body(thread_id) on the calling thread
+// (id 0) and on workers 1..count - 1, started on first use and pinned one per CPU, and returns when all are done.
+// barrier() synchronizes the team of the current call. Calls from different threads are serialized.
+class thread_pool
+{
+public:
+    thread_pool() = default;
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(state);
+            stopping = true;
+            ++generation;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    template <class Body>
+    void run(unsigned count, Body&& body)
+    {
+        std::lock_guard<std::mutex> call(calls);
+        count = count ? count : 1;
+        team_barrier.reset(count);
+        if (count == 1)
+        {
+            body(0u);
+            return;
+        }
+        start_workers(count - 1);
+        {
+            std::lock_guard<std::mutex> lock(state);
+            job = &invoke<typename std::remove_reference<Body>::type>;
+            job_context = &body;
+            active = count;
+            pending = count - 1;
+            ++generation;
+        }
+        wake.notify_all();
+        body(0u);
+        std::unique_lock<std::mutex> lock(state);
+        done.wait(lock, [this] { return pending == 0; });
+    }
+
+    spin_barrier& barrier() { return team_barrier; }
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+private:
+    template <class Body>
+    static void invoke(void* context, unsigned thread_id)
+    {
+        (*static_cast<Body*>(context))(thread_id);
+    }
+
+    void start_workers(unsigned count)
+    {
+        std::lock_guard<std::mutex> lock(state);
+        while (workers.size() < count)
+        {
+            workers.emplace_back(&thread_pool::worker_loop, this, static_cast<unsigned>(workers.size()) + 1, generation);
+        }
+    }
+
+    void worker_loop(unsigned thread_id, unsigned long long seen)
+    {
+        pin_current_thread(thread_id);
+        std::unique_lock<std::mutex> lock(state);
+        for (;;)
+        {
+            wake.wait(lock, [this, seen] { return generation != seen; });
+            seen = generation;
+            if (stopping)
+            {
+                return;
+            }
+            if (thread_id >= active)
+            {
+                continue;
+            }
+            void (*body)(void*, unsigned) = job;
+            void* context = job_context;
+            lock.unlock();
+            body(context, thread_id);
+            lock.lock();
+            if (--pending == 0)
+            {
+                done.notify_one();
+            }
+        }
+    }
+
+    std::mutex calls;
+    std::mutex state;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::vector<std::thread> workers;
+    spin_barrier team_barrier;
+    void (*job)(void*, unsigned) = nullptr;
+    void* job_context = nullptr;
+    unsigned active = 0;
+    unsigned pending = 0;
+    unsigned long long generation = 0;
+    bool stopping = false;
+};
+
+// One pool per process, shared by every entry point that forks threads
+inline thread_pool& shared_thread_pool()
+{
+    static thread_pool pool;
+    return pool;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#if defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Data-TLB load misses of the calling thread, and of threads it starts later, between start() and stop(). Linux only (perf events);
+// elsewhere, or when the kernel refuses the counter, available() is false and stop() returns -1.
+class tlb_miss_counter
+{
+public:
+    tlb_miss_counter()
+    {
+#if defined(__linux__)
+        perf_event_attr attributes;
+        std::memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        attributes.type = PERF_TYPE_HW_CACHE;
+        attributes.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attributes.disabled = 1;
+        attributes.inherit = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        descriptor_ = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+    }
+
+    ~tlb_miss_counter()
+    {
+#if defined(__linux__)
+        if (descriptor_ >= 0)
+        {
+            close(descriptor_);
+        }
+#endif
+    }
+
+    tlb_miss_counter(const tlb_miss_counter&) = delete;
+    tlb_miss_counter& operator=(const tlb_miss_counter&) = delete;
+
+    bool available() const
+    {
+        return descriptor_ >= 0;
+    }
+
+    void start()
+    {
+#if defined(__linux__)
+        if (available())
+        {
+            ioctl(descriptor_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(descriptor_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    long long stop()
+    {
+#if defined(__linux__)
+        if (available())
+        {
+            ioctl(descriptor_, PERF_EVENT_IOC_DISABLE, 0);
+            long long count = 0;
+            if (read(descriptor_, &count, sizeof(count)) == sizeof(count))
+            {
+                return count;
+            }
+        }
+#endif
+        return -1;
+    }
+
+private:
+    int descriptor_ = -1;
+};
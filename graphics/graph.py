@@ -3,6 +3,9 @@ import pandas as pd
 
 # Чтение данных
 data = pd.read_csv("output1.csv")
+# В output1.csv строки всех методов; график строится по основному параллельному
+if "Method" in data.columns:
+    data = data[data["Method"] == "parallel"]
 length = data.shape[0]
 
 # Получение данных для графиков
@@ -1,24 +1,187 @@
-﻿#include <iostream>
+﻿#include <algorithm>
+#include <iostream>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <immintrin.h>
 #include <omp.h>
 #include <thread>
 #include <fstream>
+#include <functional>
+#include <vector>
 
 const double STEPS = 100000000;
+const double ADAPTIVE_TOLERANCE = 1e-10;
+const unsigned ADAPTIVE_MAX_DEPTH = 50;
+const unsigned ADAPTIVE_TASK_DEPTH = 16;
+const std::size_t REDUCTION_BLOCK = 1 << 16;
+const std::size_t MONTE_CARLO_CHUNK = 1 << 14;
+const std::size_t MONTE_CARLO_ROUND_CHUNKS = 64;
+const std::size_t QMC_REPLICAS = 16;
+const std::uint64_t STREAM_STRIDE = std::uint64_t(1) << 40;
+const std::size_t PREFIX_BLOCK = 4096;
+
+// Nodes of the 15-point Kronrod rule on [-1, 1]; odd entries are the 7-point Gauss nodes
+static const double KRONROD_NODES[8] = {
+    0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+    0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+    0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+    0.207784955007898467600689403773245, 0.000000000000000000000000000000000
+};
+static const double KRONROD_WEIGHTS[8] = {
+    0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+    0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+    0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+    0.204432940075298892414161999234649, 0.209482141084727828012999174891714
+};
+static const double GAUSS_WEIGHTS[4] = {
+    0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+    0.381830050505118944950369775488975, 0.417959183673469387755102040816327
+};
 
 double my_function(double x)
 {
     return x * x;
 }
 
-double integral_serial(double start, double end)
+double peaked_function(double x)
+{
+    return 1.0 / (1e-6 + x * x);
+}
+
+// Lane type used by the batch integrands: the widest vector enabled at compile time
+#if defined(__AVX512F__)
+typedef __m512d simd_double;
+const std::size_t SIMD_LANES = 8;
+
+inline simd_double simd_set1(double x) { return _mm512_set1_pd(x); }
+inline simd_double simd_ramp() { return _mm512_set_pd(7, 6, 5, 4, 3, 2, 1, 0); }
+inline simd_double simd_add(simd_double a, simd_double b) { return _mm512_add_pd(a, b); }
+inline simd_double simd_sub(simd_double a, simd_double b) { return _mm512_sub_pd(a, b); }
+inline simd_double simd_mul(simd_double a, simd_double b) { return _mm512_mul_pd(a, b); }
+inline simd_double simd_fmadd(simd_double a, simd_double b, simd_double c) { return _mm512_fmadd_pd(a, b, c); }
+inline simd_double simd_round(simd_double x) { return _mm512_roundscale_pd(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+inline simd_double simd_floor(simd_double x) { return _mm512_roundscale_pd(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+inline simd_double simd_scale_pow2(simd_double x, simd_double n) { return _mm512_scalef_pd(x, n); }
+inline double simd_sum(simd_double x) { return _mm512_reduce_add_pd(x); }
+#elif defined(__AVX2__)
+typedef __m256d simd_double;
+const std::size_t SIMD_LANES = 4;
+
+inline simd_double simd_set1(double x) { return _mm256_set1_pd(x); }
+inline simd_double simd_ramp() { return _mm256_set_pd(3, 2, 1, 0); }
+inline simd_double simd_add(simd_double a, simd_double b) { return _mm256_add_pd(a, b); }
+inline simd_double simd_sub(simd_double a, simd_double b) { return _mm256_sub_pd(a, b); }
+inline simd_double simd_mul(simd_double a, simd_double b) { return _mm256_mul_pd(a, b); }
+inline simd_double simd_fmadd(simd_double a, simd_double b, simd_double c) { return _mm256_fmadd_pd(a, b, c); }
+inline simd_double simd_round(simd_double x) { return _mm256_round_pd(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+inline simd_double simd_floor(simd_double x) { return _mm256_floor_pd(x); }
+// n must be integral and within the normal exponent range
+inline simd_double simd_scale_pow2(simd_double x, simd_double n)
+{
+    __m256i exponent = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+    exponent = _mm256_slli_epi64(_mm256_add_epi64(exponent, _mm256_set1_epi64x(1023)), 52);
+    return _mm256_mul_pd(x, _mm256_castsi256_pd(exponent));
+}
+inline double simd_sum(simd_double x)
+{
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(x), _mm256_extractf128_pd(x, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+}
+#else
+typedef double simd_double;
+const std::size_t SIMD_LANES = 1;
+
+inline simd_double simd_set1(double x) { return x; }
+inline simd_double simd_ramp() { return 0; }
+inline simd_double simd_add(simd_double a, simd_double b) { return a + b; }
+inline simd_double simd_sub(simd_double a, simd_double b) { return a - b; }
+inline simd_double simd_mul(simd_double a, simd_double b) { return a * b; }
+inline simd_double simd_fmadd(simd_double a, simd_double b, simd_double c) { return a * b + c; }
+inline simd_double simd_round(simd_double x) { return std::nearbyint(x); }
+inline simd_double simd_floor(simd_double x) { return std::floor(x); }
+inline simd_double simd_scale_pow2(simd_double x, simd_double n) { return std::ldexp(x, static_cast<int>(n)); }
+inline double simd_sum(simd_double x) { return x; }
+#endif
+
+// e^x for |x| < 708: x = k*ln2 + r, |r| <= ln2/2, Taylor series of degree 12 for e^r
+inline simd_double simd_exp(simd_double x)
+{
+    simd_double k = simd_round(simd_mul(x, simd_set1(1.4426950408889634)));
+    simd_double r = simd_fmadd(k, simd_set1(-6.93147180369123816490e-01), x);
+    r = simd_fmadd(k, simd_set1(-1.90821492927058770002e-10), r);
+
+    simd_double p = simd_set1(1.0 / 479001600);
+    const double coefficients[12] = { 1.0 / 39916800, 1.0 / 3628800, 1.0 / 362880, 1.0 / 40320, 1.0 / 5040, 1.0 / 720,
+        1.0 / 120, 1.0 / 24, 1.0 / 6, 1.0 / 2, 1.0, 1.0 };
+    for (double c : coefficients)
+    {
+        p = simd_fmadd(p, r, simd_set1(c));
+    }
+    return simd_scale_pow2(p, k);
+}
+
+// sin(x) for moderate |x|: x = k*pi + r, |r| <= pi/2, sin(x) = (-1)^k * sin(r) with an odd Taylor series up to r^21
+inline simd_double simd_sin(simd_double x)
+{
+    simd_double k = simd_round(simd_mul(x, simd_set1(0.31830988618379067154)));
+    simd_double r = simd_fmadd(k, simd_set1(-3.14159265358979311600e+00), x);
+    r = simd_fmadd(k, simd_set1(-1.22464679914735320717e-16), r);
+    simd_double r2 = simd_mul(r, r);
+
+    simd_double p = simd_set1(1.0 / 51090942171709440000.0);
+    const double coefficients[10] = { -1.0 / 121645100408832000.0, 1.0 / 355687428096000.0, -1.0 / 1307674368000.0,
+        1.0 / 6227020800.0, -1.0 / 39916800, 1.0 / 362880, -1.0 / 5040, 1.0 / 120, -1.0 / 6, 1.0 };
+    for (double c : coefficients)
+    {
+        p = simd_fmadd(p, r2, simd_set1(c));
+    }
+
+    simd_double parity = simd_fmadd(simd_floor(simd_mul(k, simd_set1(0.5))), simd_set1(-2.0), k);
+    simd_double sign = simd_fmadd(parity, simd_set1(-2.0), simd_set1(1.0));
+    return simd_mul(simd_mul(p, r), sign);
+}
+
+// Integrands for integral_simd: operator() evaluates one point, batch() evaluates SIMD_LANES points at once
+struct square_function
+{
+    double operator()(double x) const { return x * x; }
+    simd_double batch(simd_double x) const { return simd_mul(x, x); }
+};
+
+struct polynomial_function
+{
+    double operator()(double x) const { return (((0.2 * x - 0.25) * x + 3.0) * x - 0.5) * x + 1.0; }
+    simd_double batch(simd_double x) const
+    {
+        simd_double p = simd_fmadd(simd_set1(0.2), x, simd_set1(-0.25));
+        p = simd_fmadd(p, x, simd_set1(3.0));
+        p = simd_fmadd(p, x, simd_set1(-0.5));
+        return simd_fmadd(p, x, simd_set1(1.0));
+    }
+};
+
+struct exp_function
+{
+    double operator()(double x) const { return std::exp(x); }
+    simd_double batch(simd_double x) const { return simd_exp(x); }
+};
+
+struct sin_function
+{
+    double operator()(double x) const { return std::sin(x); }
+    simd_double batch(simd_double x) const { return simd_sin(x); }
+};
+
+template <class F>
+double integral_serial(F f, double start, double end)
 {
     double total = 0;
     double step_size = (end - start) / STEPS;
 
     for (std::size_t i = 0; i < STEPS; ++i)
     {
-        total += my_function(start + i * step_size);
+        total += f(start + i * step_size);
     }
 
     return step_size * total;
@@ -49,6 +212,627 @@ double integral_parallel(double start, double end)
     return step_size * total;
 }
 
+// Same left-rectangle sum as integral_parallel, but every thread walks one contiguous block
+// and evaluates SIMD_LANES points per call with four independent accumulators.
+template <class F>
+double integral_simd(F f, double start, double end)
+{
+    const std::size_t steps = static_cast<std::size_t>(STEPS);
+    const std::size_t unroll = 4;
+    double total = 0;
+    double step_size = (end - start) / STEPS;
+
+#pragma omp parallel
+    {
+        std::size_t thread_id = omp_get_thread_num();
+        std::size_t thread_count = omp_get_num_threads();
+        std::size_t block_begin = steps * thread_id / thread_count;
+        std::size_t block_end = steps * (thread_id + 1) / thread_count;
+
+        simd_double lanes = simd_ramp();
+        simd_double step = simd_set1(step_size);
+        simd_double origin = simd_set1(start);
+        simd_double acc[unroll] = { simd_set1(0), simd_set1(0), simd_set1(0), simd_set1(0) };
+
+        std::size_t i = block_begin;
+        for (; i + unroll * SIMD_LANES <= block_end; i += unroll * SIMD_LANES)
+        {
+            for (std::size_t u = 0; u < unroll; ++u)
+            {
+                simd_double x = simd_fmadd(simd_add(simd_set1(static_cast<double>(i + u * SIMD_LANES)), lanes), step, origin);
+                acc[u] = simd_add(acc[u], f.batch(x));
+            }
+        }
+        for (; i + SIMD_LANES <= block_end; i += SIMD_LANES)
+        {
+            simd_double x = simd_fmadd(simd_add(simd_set1(static_cast<double>(i)), lanes), step, origin);
+            acc[0] = simd_add(acc[0], f.batch(x));
+        }
+
+        double local_res = simd_sum(simd_add(simd_add(acc[0], acc[1]), simd_add(acc[2], acc[3])));
+        for (; i < block_end; ++i)
+        {
+            local_res += f(start + i * step_size);
+        }
+
+#pragma omp critical
+        {
+            total += local_res;
+        }
+    }
+
+    return step_size * total;
+}
+
+// Kahan step: sum + value is accumulated while compensation keeps the (negated) lost low-order bits
+inline void kahan_add(simd_double& sum, simd_double& compensation, simd_double value)
+{
+    simd_double y = simd_sub(value, compensation);
+    simd_double t = simd_add(sum, y);
+    compensation = simd_sub(simd_sub(t, sum), y);
+    sum = t;
+}
+
+inline void kahan_add_scalar(double& sum, double& compensation, double value)
+{
+    double y = value - compensation;
+    double t = sum + y;
+    compensation = (t - sum) - y;
+    sum = t;
+}
+
+// Compensated sum of f over points [begin, end). The operation order depends only on the range,
+// never on which thread evaluates it.
+template <class F>
+double block_sum_compensated(F f, double start, double step_size, std::size_t begin, std::size_t end)
+{
+    const std::size_t unroll = 4;
+    simd_double lanes = simd_ramp();
+    simd_double step = simd_set1(step_size);
+    simd_double origin = simd_set1(start);
+    simd_double sum[unroll] = { simd_set1(0), simd_set1(0), simd_set1(0), simd_set1(0) };
+    simd_double compensation[unroll] = { simd_set1(0), simd_set1(0), simd_set1(0), simd_set1(0) };
+
+    std::size_t i = begin;
+    for (; i + unroll * SIMD_LANES <= end; i += unroll * SIMD_LANES)
+    {
+        for (std::size_t u = 0; u < unroll; ++u)
+        {
+            simd_double x = simd_fmadd(simd_add(simd_set1(static_cast<double>(i + u * SIMD_LANES)), lanes), step, origin);
+            kahan_add(sum[u], compensation[u], f.batch(x));
+        }
+    }
+
+    double lane_sums[unroll * SIMD_LANES], lane_compensations[unroll * SIMD_LANES];
+    for (std::size_t u = 0; u < unroll; ++u)
+    {
+        for (std::size_t lane = 0; lane < SIMD_LANES; ++lane)
+        {
+            lane_sums[u * SIMD_LANES + lane] = reinterpret_cast<const double*>(&sum[u])[lane];
+            lane_compensations[u * SIMD_LANES + lane] = reinterpret_cast<const double*>(&compensation[u])[lane];
+        }
+    }
+
+    double total = 0, total_compensation = 0;
+    for (std::size_t k = 0; k < unroll * SIMD_LANES; ++k)
+    {
+        kahan_add_scalar(total, total_compensation, lane_sums[k]);
+        kahan_add_scalar(total, total_compensation, -lane_compensations[k]);
+    }
+    for (; i < end; ++i)
+    {
+        kahan_add_scalar(total, total_compensation, f(start + i * step_size));
+    }
+
+    return total - total_compensation;
+}
+
+// Fixed-shape combine tree: the split points depend only on count
+double pairwise_sum(const double* values, std::size_t count)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    if (count == 1)
+    {
+        return values[0];
+    }
+    std::size_t half = count / 2;
+    return pairwise_sum(values, half) + pairwise_sum(values + half, count - half);
+}
+
+// Left-rectangle sum that is bit-identical for every thread count: points are cut into
+// REDUCTION_BLOCK-sized blocks, each block is summed with Kahan compensation by whichever
+// thread owns it, and the block sums are merged by pairwise_sum.
+template <class F>
+double integral_deterministic(F f, double start, double end)
+{
+    const std::size_t steps = static_cast<std::size_t>(STEPS);
+    const std::size_t block_count = (steps + REDUCTION_BLOCK - 1) / REDUCTION_BLOCK;
+    double step_size = (end - start) / STEPS;
+    std::vector<double> block_sums(block_count);
+
+#pragma omp parallel for schedule(static)
+    for (std::ptrdiff_t block = 0; block < static_cast<std::ptrdiff_t>(block_count); ++block)
+    {
+        std::size_t begin = block * REDUCTION_BLOCK;
+        std::size_t block_end = std::min(begin + REDUCTION_BLOCK, steps);
+        block_sums[block] = block_sum_compensated(f, start, step_size, begin, block_end);
+    }
+
+    return step_size * pairwise_sum(block_sums.data(), block_count);
+}
+
+struct quadrature_result
+{
+    double value;
+    double error;
+    std::size_t evaluations;
+};
+
+template <class F>
+quadrature_result gauss_kronrod_15(F f, double start, double end)
+{
+    double center = 0.5 * (start + end);
+    double half_length = 0.5 * (end - start);
+    double f_center = f(center);
+    double kronrod = KRONROD_WEIGHTS[7] * f_center;
+    double gauss = GAUSS_WEIGHTS[3] * f_center;
+
+    for (std::size_t j = 0; j < 7; ++j)
+    {
+        double dx = half_length * KRONROD_NODES[j];
+        double f_sum = f(center - dx) + f(center + dx);
+        kronrod += KRONROD_WEIGHTS[j] * f_sum;
+        if (j % 2 == 1)
+        {
+            gauss += GAUSS_WEIGHTS[j / 2] * f_sum;
+        }
+    }
+
+    return { kronrod * half_length, std::abs((kronrod - gauss) * half_length), 15 };
+}
+
+// Splits [start, end] in half until the Gauss/Kronrod difference fits the tolerance.
+// Halves above ADAPTIVE_TASK_DEPTH become OpenMP tasks, so hard regions spread over idle threads.
+// Partial results are always summed in the same tree order, hence the result does not depend on T.
+template <class F>
+quadrature_result adaptive_segment(F f, double start, double end, double tolerance, unsigned depth, bool spawn_tasks)
+{
+    quadrature_result whole = gauss_kronrod_15(f, start, end);
+    if (whole.error <= tolerance || depth >= ADAPTIVE_MAX_DEPTH)
+    {
+        return whole;
+    }
+
+    double middle = 0.5 * (start + end);
+    quadrature_result left, right;
+    if (spawn_tasks && depth < ADAPTIVE_TASK_DEPTH)
+    {
+#pragma omp task shared(left)
+        left = adaptive_segment(f, start, middle, tolerance / 2, depth + 1, true);
+        right = adaptive_segment(f, middle, end, tolerance / 2, depth + 1, true);
+#pragma omp taskwait
+    }
+    else
+    {
+        left = adaptive_segment(f, start, middle, tolerance / 2, depth + 1, false);
+        right = adaptive_segment(f, middle, end, tolerance / 2, depth + 1, false);
+    }
+
+    return { left.value + right.value, left.error + right.error, whole.evaluations + left.evaluations + right.evaluations };
+}
+
+template <class F>
+quadrature_result integral_adaptive(F f, double start, double end, double tolerance)
+{
+    quadrature_result result{};
+
+#pragma omp parallel
+    {
+#pragma omp single
+        {
+            result = adaptive_segment(f, start, end, tolerance, 0, true);
+        }
+    }
+
+    return result;
+}
+
+struct integration_job
+{
+    std::function<double(double)> integrand;
+    double start;
+    double end;
+    double tolerance;
+};
+
+// Integrates every job inside a single parallel region. Jobs are handed out one at a time,
+// so a few expensive integrands do not stall the team, and each job is refined serially
+// because the batch itself already keeps all threads busy.
+std::vector<quadrature_result> integrate_batch(const std::vector<integration_job>& jobs)
+{
+    std::vector<quadrature_result> results(jobs.size());
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (std::ptrdiff_t j = 0; j < static_cast<std::ptrdiff_t>(jobs.size()); ++j)
+    {
+        const integration_job& job = jobs[j];
+        results[j] = adaptive_segment(std::cref(job.integrand), job.start, job.end, job.tolerance, 0, false);
+    }
+
+    return results;
+}
+
+// Cumulative trapezoid integral of an integrand sampled once on a uniform grid of `intervals` cells.
+// Nodes are grouped in PREFIX_BLOCK blocks: local_sums_[i] is the integral from the first node of
+// i's block up to node i, block_offsets_[b] the integral from start up to block b. A range query is
+// two such lookups plus the exact integral of the linear interpolant inside the end cells, so it
+// costs O(1). Replacing samples only rescans the touched blocks and the block offsets.
+class prefix_integral_table
+{
+public:
+    template <class F>
+    void build(F f, double start, double end, std::size_t intervals)
+    {
+        start_ = start;
+        step_ = (end - start) / intervals;
+        samples_.resize(intervals + 1);
+        local_sums_.resize(intervals + 1);
+        block_totals_.resize(intervals / PREFIX_BLOCK + 1);
+        block_offsets_.resize(block_totals_.size());
+
+#pragma omp parallel for schedule(static)
+        for (std::ptrdiff_t i = 0; i <= static_cast<std::ptrdiff_t>(intervals); ++i)
+        {
+            samples_[i] = f(start + i * step_);
+        }
+
+#pragma omp parallel for schedule(static)
+        for (std::ptrdiff_t block = 0; block < static_cast<std::ptrdiff_t>(block_totals_.size()); ++block)
+        {
+            scan_block(block);
+        }
+
+        scan_offsets(0);
+    }
+
+    double sample(std::size_t i) const
+    {
+        return samples_[i];
+    }
+
+    double step() const
+    {
+        return step_;
+    }
+
+    // Integral of the piecewise-linear interpolant over [a, b]
+    double integral(double a, double b) const
+    {
+        return cumulative(b) - cumulative(a);
+    }
+
+    // Replaces samples [first, first + count) and refreshes the sums that depend on them
+    void update(std::size_t first, const double* values, std::size_t count)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        std::copy(values, values + count, samples_.begin() + first);
+
+        // Cells first - 1 .. first + count - 1 touch the new samples
+        std::size_t first_block = (first == 0 ? 0 : first - 1) / PREFIX_BLOCK;
+        std::size_t last_block = std::min(first + count - 1, samples_.size() - 2) / PREFIX_BLOCK;
+        for (std::size_t block = first_block; block <= last_block; ++block)
+        {
+            scan_block(block);
+        }
+        scan_offsets(first_block);
+    }
+
+private:
+    double cumulative(double x) const
+    {
+        const std::size_t intervals = samples_.size() - 1;
+        double t = (x - start_) / step_;
+        double cell = std::floor(t);
+        std::size_t i = cell < 0 ? 0 : std::min(static_cast<std::size_t>(cell), intervals - 1);
+        double fraction = t - static_cast<double>(i);
+        double node = block_offsets_[i / PREFIX_BLOCK] + local_sums_[i];
+        return node + step_ * fraction * (samples_[i] + 0.5 * fraction * (samples_[i + 1] - samples_[i]));
+    }
+
+    // Local prefix sums of one block; its total includes the cell that leaves the block
+    void scan_block(std::size_t block)
+    {
+        const std::size_t intervals = samples_.size() - 1;
+        std::size_t begin = block * PREFIX_BLOCK;
+        std::size_t end = std::min(begin + PREFIX_BLOCK, intervals + 1);
+        double sum = 0;
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            local_sums_[i] = sum;
+            if (i < intervals)
+            {
+                sum += 0.5 * step_ * (samples_[i] + samples_[i + 1]);
+            }
+        }
+        block_totals_[block] = sum;
+    }
+
+    void scan_offsets(std::size_t first_block)
+    {
+        double offset = first_block == 0 ? 0 : block_offsets_[first_block - 1] + block_totals_[first_block - 1];
+        for (std::size_t block = first_block; block < block_offsets_.size(); ++block)
+        {
+            block_offsets_[block] = offset;
+            offset += block_totals_[block];
+        }
+    }
+
+    double start_ = 0;
+    double step_ = 0;
+    std::vector<double> samples_;
+    std::vector<double> local_sums_;
+    std::vector<double> block_totals_;
+    std::vector<double> block_offsets_;
+};
+
+// PCG-XSH-RR: a 64-bit LCG with a permuted 32-bit output. advance() jumps the LCG the same way
+// randomize() in lab4 derives thread seeds, i.e. state * a^n + c * (a^n - 1) / (a - 1),
+// with both terms built by repeated squaring.
+struct pcg32
+{
+    static const std::uint64_t MULTIPLIER = 6364136223846793005ULL;
+    static const std::uint64_t INCREMENT = 1442695040888963407ULL;
+    std::uint64_t state;
+
+    explicit pcg32(std::uint64_t seed) : state(seed + INCREMENT)
+    {
+        next();
+    }
+
+    std::uint32_t next()
+    {
+        std::uint64_t old = state;
+        state = old * MULTIPLIER + INCREMENT;
+        std::uint32_t xorshifted = static_cast<std::uint32_t>(((old >> 18) ^ old) >> 27);
+        std::uint32_t rotation = static_cast<std::uint32_t>(old >> 59);
+        return (xorshifted >> rotation) | (xorshifted << ((32 - rotation) & 31));
+    }
+
+    // Uniform in [0, 1) with 53 random bits
+    double next_double()
+    {
+        std::uint64_t bits = (static_cast<std::uint64_t>(next()) << 32) | next();
+        return (bits >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    void advance(std::uint64_t delta)
+    {
+        std::uint64_t acc_multiplier = 1, acc_increment = 0;
+        std::uint64_t cur_multiplier = MULTIPLIER, cur_increment = INCREMENT;
+        while (delta > 0)
+        {
+            if (delta & 1)
+            {
+                acc_multiplier *= cur_multiplier;
+                acc_increment = acc_increment * cur_multiplier + cur_increment;
+            }
+            cur_increment = (cur_multiplier + 1) * cur_increment;
+            cur_multiplier *= cur_multiplier;
+            delta >>= 1;
+        }
+        state = acc_multiplier * state + acc_increment;
+    }
+};
+
+static const unsigned HALTON_PRIMES[32] = {
+    2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+    59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131
+};
+
+double radical_inverse(std::uint64_t index, unsigned base)
+{
+    double inverse_base = 1.0 / base;
+    double digit_weight = inverse_base;
+    double result = 0;
+    while (index > 0)
+    {
+        result += (index % base) * digit_weight;
+        index /= base;
+        digit_weight *= inverse_base;
+    }
+    return result;
+}
+
+struct monte_carlo_result
+{
+    double value;
+    double error;
+    std::size_t samples;
+};
+
+// Running mean and sum of squared deviations; merge() is Chan's parallel update
+struct sample_statistics
+{
+    double count;
+    double mean;
+    double m2;
+
+    void add(double value)
+    {
+        count += 1;
+        double delta = value - mean;
+        mean += delta / count;
+        m2 += delta * (value - mean);
+    }
+
+    void merge(const sample_statistics& other)
+    {
+        if (other.count == 0)
+        {
+            return;
+        }
+        double total = count + other.count;
+        double delta = other.mean - mean;
+        mean += delta * other.count / total;
+        m2 += other.m2 + delta * delta * count * other.count / total;
+        count = total;
+    }
+};
+
+// Plain Monte Carlo over the box [lower, upper]. Samples come in MONTE_CARLO_CHUNK chunks and
+// chunk c draws from its own stream, seed advanced by c * STREAM_STRIDE, so the streams never
+// overlap and the estimate does not depend on which thread ran the chunk. After every round
+// the standard error is checked against target_error.
+template <class F>
+monte_carlo_result integral_monte_carlo(F f, const std::vector<double>& lower, const std::vector<double>& upper,
+    double target_error, std::size_t max_samples, std::uint64_t seed)
+{
+    const std::size_t dims = lower.size();
+    double volume = 1;
+    for (std::size_t d = 0; d < dims; ++d)
+    {
+        volume *= upper[d] - lower[d];
+    }
+
+    sample_statistics total = { 0, 0, 0 };
+    std::vector<sample_statistics> chunk_statistics(MONTE_CARLO_ROUND_CHUNKS);
+    double error = 0;
+    for (std::size_t first_chunk = 0; static_cast<std::size_t>(total.count) < max_samples; first_chunk += MONTE_CARLO_ROUND_CHUNKS)
+    {
+#pragma omp parallel
+        {
+            std::vector<double> point(dims);
+#pragma omp for schedule(dynamic)
+            for (std::ptrdiff_t c = 0; c < static_cast<std::ptrdiff_t>(MONTE_CARLO_ROUND_CHUNKS); ++c)
+            {
+                pcg32 generator(seed);
+                generator.advance((first_chunk + c) * STREAM_STRIDE);
+                sample_statistics statistics = { 0, 0, 0 };
+                for (std::size_t i = 0; i < MONTE_CARLO_CHUNK; ++i)
+                {
+                    for (std::size_t d = 0; d < dims; ++d)
+                    {
+                        point[d] = lower[d] + (upper[d] - lower[d]) * generator.next_double();
+                    }
+                    statistics.add(f(point.data(), dims));
+                }
+                chunk_statistics[c] = statistics;
+            }
+        }
+
+        for (const sample_statistics& statistics : chunk_statistics)
+        {
+            total.merge(statistics);
+        }
+        error = volume * std::sqrt(total.m2 / (total.count - 1) / total.count);
+        if (error <= target_error)
+        {
+            break;
+        }
+    }
+
+    return { volume * total.mean, error, static_cast<std::size_t>(total.count) };
+}
+
+// Randomized quasi-Monte Carlo: QMC_REPLICAS copies of the Halton sequence, each under its own
+// random Cranley-Patterson shift. Replicas are independent unbiased estimates, so their spread
+// gives the running error. Chunks of Halton indices are spread over the threads.
+template <class F>
+monte_carlo_result integral_quasi_monte_carlo(F f, const std::vector<double>& lower, const std::vector<double>& upper,
+    double target_error, std::size_t max_samples, std::uint64_t seed)
+{
+    const std::size_t dims = lower.size();
+    const std::size_t chunks_per_replica = MONTE_CARLO_ROUND_CHUNKS / QMC_REPLICAS;
+    if (dims > sizeof(HALTON_PRIMES) / sizeof(HALTON_PRIMES[0]))
+    {
+        return { 0, -1, 0 };
+    }
+
+    double volume = 1;
+    for (std::size_t d = 0; d < dims; ++d)
+    {
+        volume *= upper[d] - lower[d];
+    }
+
+    std::vector<double> shifts(QMC_REPLICAS * dims);
+    pcg32 shift_generator(seed);
+    for (double& shift : shifts)
+    {
+        shift = shift_generator.next_double();
+    }
+
+    std::vector<double> replica_sums(QMC_REPLICAS, 0.0);
+    std::vector<double> chunk_sums(MONTE_CARLO_ROUND_CHUNKS);
+    std::size_t points_per_replica = 0;
+    double estimate = 0, error = 0;
+    while (points_per_replica * QMC_REPLICAS < max_samples)
+    {
+#pragma omp parallel
+        {
+            std::vector<double> point(dims);
+#pragma omp for schedule(dynamic)
+            for (std::ptrdiff_t c = 0; c < static_cast<std::ptrdiff_t>(MONTE_CARLO_ROUND_CHUNKS); ++c)
+            {
+                const double* shift = &shifts[(c / chunks_per_replica) * dims];
+                std::size_t first_index = points_per_replica + (c % chunks_per_replica) * MONTE_CARLO_CHUNK;
+                double sum = 0;
+                for (std::size_t i = first_index; i < first_index + MONTE_CARLO_CHUNK; ++i)
+                {
+                    for (std::size_t d = 0; d < dims; ++d)
+                    {
+                        double u = radical_inverse(i + 1, HALTON_PRIMES[d]) + shift[d];
+                        u -= u >= 1.0 ? 1.0 : 0.0;
+                        point[d] = lower[d] + (upper[d] - lower[d]) * u;
+                    }
+                    sum += f(point.data(), dims);
+                }
+                chunk_sums[c] = sum;
+            }
+        }
+
+        for (std::size_t c = 0; c < MONTE_CARLO_ROUND_CHUNKS; ++c)
+        {
+            replica_sums[c / chunks_per_replica] += chunk_sums[c];
+        }
+        points_per_replica += chunks_per_replica * MONTE_CARLO_CHUNK;
+
+        sample_statistics replicas = { 0, 0, 0 };
+        for (double sum : replica_sums)
+        {
+            replicas.add(volume * sum / points_per_replica);
+        }
+        estimate = replicas.mean;
+        error = std::sqrt(replicas.m2 / (QMC_REPLICAS - 1) / QMC_REPLICAS);
+        if (error <= target_error)
+        {
+            break;
+        }
+    }
+
+    return { estimate, error, points_per_replica * QMC_REPLICAS };
+}
+
+// prod_d (pi / 2) sin(pi x_d), integrates to 1 over the unit cube of any dimension
+struct sine_product_function
+{
+    double operator()(const double* x, std::size_t dims) const
+    {
+        const double pi = 3.14159265358979323846;
+        double product = 1;
+        for (std::size_t d = 0; d < dims; ++d)
+        {
+            product *= 0.5 * pi * std::sin(pi * x[d]);
+        }
+        return product;
+    }
+};
+
 int main()
 {
     std::ofstream file("output1.csv");
@@ -58,15 +842,15 @@ int main()
         return 1;
     }
 
-    file << "T,Duration,Speedup\n";
+    file << "Method,T,Duration,Speedup\n";
 
     double start_time = omp_get_wtime();
-    double serial_result = integral_serial(-1, 1);
+    double serial_result = integral_serial(my_function, -1, 1);
     double serial_duration = omp_get_wtime() - start_time;
 
     std::cout << "Serial: Threads = 1, Result = " << serial_result
         << ", Time = " << serial_duration << "s, Speedup = 1.0\n";
-    file << "1," << serial_duration << ",1.0\n";
+    file << "serial,1," << serial_duration << ",1.0\n";
 
     for (std::size_t threads = 2; threads <= std::thread::hardware_concurrency(); ++threads)
     {
@@ -77,9 +861,264 @@ int main()
 
         std::cout << "Parallel: Threads = " << threads << ", Result = " << parallel_result
             << ", Time = " << parallel_duration << "s, Speedup = " << serial_duration / parallel_duration << "\n";
-        file << threads << "," << parallel_duration << "," << (serial_duration / parallel_duration) << "\n";
+        file << "parallel," << threads << "," << parallel_duration << "," << (serial_duration / parallel_duration) << "\n";
+    }
+
+    // Deterministic reduction: every T must reproduce the T = 1 bits exactly.
+    // The reference is the exact left Riemann sum of x^2 with STEPS points.
+    const long double h = 2.0L / STEPS;
+    const long double n = STEPS;
+    const long double riemann_exact = h * (n - h * n * (n - 1) + h * h * (n - 1) * n * (2 * n - 1) / 6);
+    double deterministic_reference = 0;
+    for (std::size_t threads = 1; threads <= std::thread::hardware_concurrency(); ++threads)
+    {
+        omp_set_num_threads(threads);
+        start_time = omp_get_wtime();
+        double deterministic_result = integral_deterministic(square_function(), -1, 1);
+        double deterministic_duration = omp_get_wtime() - start_time;
+
+        if (threads == 1)
+        {
+            deterministic_reference = deterministic_result;
+        }
+        else if (deterministic_result != deterministic_reference)
+        {
+            std::cerr << "Deterministic result changed with T = " << threads << ": " << deterministic_result << "\n";
+            return 1;
+        }
+
+        std::cout << "Deterministic: Threads = " << threads << ", Result = " << deterministic_result
+            << ", Error = " << static_cast<double>(deterministic_result - riemann_exact)
+            << " (plain serial: " << static_cast<double>(serial_result - riemann_exact) << ")"
+            << ", Time = " << deterministic_duration << "s, Speedup = " << serial_duration / deterministic_duration << "\n";
+        file << "deterministic," << threads << "," << deterministic_duration << "," << (serial_duration / deterministic_duration) << "\n";
     }
 
+    // Speedups of the adaptive rows are relative to the serial rectangle sum above
+    const double peak_exact = 2.0 / std::sqrt(1e-6) * std::atan(1.0 / std::sqrt(1e-6));
+    for (std::size_t threads = 1; threads <= std::thread::hardware_concurrency(); ++threads)
+    {
+        omp_set_num_threads(threads);
+        start_time = omp_get_wtime();
+        quadrature_result adaptive = integral_adaptive(my_function, -1, 1, ADAPTIVE_TOLERANCE);
+        double adaptive_duration = omp_get_wtime() - start_time;
+
+        start_time = omp_get_wtime();
+        quadrature_result peak = integral_adaptive(peaked_function, -1, 1, ADAPTIVE_TOLERANCE);
+        double peak_duration = omp_get_wtime() - start_time;
+
+        if (std::abs(adaptive.value - 2.0 / 3.0) > ADAPTIVE_TOLERANCE || std::abs(peak.value - peak_exact) > 1e-6 * peak_exact)
+        {
+            std::cerr << "Adaptive integration failed: " << adaptive.value << ", " << peak.value << "\n";
+            return 1;
+        }
+
+        std::cout << "Adaptive: Threads = " << threads << ", Result = " << adaptive.value
+            << ", Evaluations = " << adaptive.evaluations << ", Time = " << adaptive_duration << "s"
+            << "; peaked Result = " << peak.value << ", Evaluations = " << peak.evaluations
+            << ", Time = " << peak_duration << "s\n";
+        file << "adaptive," << threads << "," << adaptive_duration << "," << (serial_duration / adaptive_duration) << "\n";
+        file << "adaptive_peak," << threads << "," << peak_duration << "," << (serial_duration / peak_duration) << "\n";
+    }
+
+    // SIMD integrands, each against its own scalar serial sum
+    auto simd_benchmark = [&file](const char* name, auto f, double start, double end)
+        {
+            double start_time = omp_get_wtime();
+            double scalar_result = integral_serial(f, start, end);
+            double scalar_duration = omp_get_wtime() - start_time;
+
+            std::cout << "Serial " << name << ": Threads = 1, Result = " << scalar_result
+                << ", Time = " << scalar_duration << "s, Speedup = 1.0\n";
+            file << "serial_" << name << ",1," << scalar_duration << ",1.0\n";
+
+            for (std::size_t threads = 1; threads <= std::thread::hardware_concurrency(); ++threads)
+            {
+                omp_set_num_threads(threads);
+                start_time = omp_get_wtime();
+                double simd_result = integral_simd(f, start, end);
+                double simd_duration = omp_get_wtime() - start_time;
+
+                if (std::abs(simd_result - scalar_result) > 1e-9 * (1 + std::abs(scalar_result)))
+                {
+                    std::cerr << "SIMD " << name << " result " << simd_result << " differs from " << scalar_result << "\n";
+                    return false;
+                }
+
+                std::cout << "SIMD " << name << ": Threads = " << threads << ", Lanes = " << SIMD_LANES << ", Result = " << simd_result
+                    << ", Time = " << simd_duration << "s, Speedup = " << scalar_duration / simd_duration << "\n";
+                file << "simd_" << name << "," << threads << "," << simd_duration << "," << (scalar_duration / simd_duration) << "\n";
+            }
+            return true;
+        };
+
+    if (!simd_benchmark("square", square_function(), -1, 1) ||
+        !simd_benchmark("polynomial", polynomial_function(), -1, 1) ||
+        !simd_benchmark("exp", exp_function(), -1, 1) ||
+        !simd_benchmark("sin", sin_function(), 0, 3.14159265358979323846))
+    {
+        return 1;
+    }
+
+    // Many small integrals: a loop of integral_adaptive calls against one integrate_batch call
+    // (speedups relative to the loop at T = 1)
+    const std::size_t job_count = 20000;
+    std::vector<integration_job> jobs;
+    jobs.reserve(job_count);
+    for (std::size_t j = 0; j < job_count; ++j)
+    {
+        double a = 1.0 + j % 100;
+        jobs.push_back({ [a](double x) { return std::exp(-a * x * x); }, -1.0 - j % 7, 1.0 + j % 5, ADAPTIVE_TOLERANCE });
+    }
+    double batch_loop_base = 0;
+    for (std::size_t threads = 1; threads <= std::thread::hardware_concurrency(); ++threads)
+    {
+        omp_set_num_threads(threads);
+        std::vector<quadrature_result> loop_results(job_count);
+        start_time = omp_get_wtime();
+        for (std::size_t j = 0; j < job_count; ++j)
+        {
+            loop_results[j] = integral_adaptive(std::cref(jobs[j].integrand), jobs[j].start, jobs[j].end, jobs[j].tolerance);
+        }
+        double loop_duration = omp_get_wtime() - start_time;
+
+        start_time = omp_get_wtime();
+        std::vector<quadrature_result> batch_results = integrate_batch(jobs);
+        double batch_duration = omp_get_wtime() - start_time;
+
+        for (std::size_t j = 0; j < job_count; ++j)
+        {
+            if (batch_results[j].value != loop_results[j].value)
+            {
+                std::cerr << "Batch job " << j << " result " << batch_results[j].value << " differs from " << loop_results[j].value << "\n";
+                return 1;
+            }
+        }
+        if (threads == 1)
+        {
+            batch_loop_base = loop_duration;
+        }
+
+        std::cout << "Batch: Threads = " << threads << ", Jobs = " << job_count
+            << ", Loop jobs/s = " << job_count / loop_duration << ", Batch jobs/s = " << job_count / batch_duration << "\n";
+        file << "adaptive_loop," << threads << "," << loop_duration << "," << (batch_loop_base / loop_duration) << "\n";
+        file << "batch," << threads << "," << batch_duration << "," << (batch_loop_base / batch_duration) << "\n";
+    }
+
+    // Prefix-sum table: parallel build (speedups relative to T = 1), then O(1) range queries
+    // and incremental updates on the last table
+    const std::size_t table_intervals = std::size_t(1) << 22;
+    prefix_integral_table table;
+    double table_build_base = 0;
+    for (std::size_t threads = 1; threads <= std::thread::hardware_concurrency(); ++threads)
+    {
+        omp_set_num_threads(threads);
+        start_time = omp_get_wtime();
+        table.build(my_function, -1, 1, table_intervals);
+        double build_duration = omp_get_wtime() - start_time;
+        if (threads == 1)
+        {
+            table_build_base = build_duration;
+        }
+
+        std::cout << "Prefix table build: Threads = " << threads << ", Intervals = " << table_intervals
+            << ", Time = " << build_duration << "s, Speedup = " << table_build_base / build_duration << "\n";
+        file << "prefix_build," << threads << "," << build_duration << "," << (table_build_base / build_duration) << "\n";
+    }
+
+    const std::size_t query_count = 1000000;
+    pcg32 query_generator(1);
+    std::vector<double> query_bounds(2 * query_count), query_results(query_count);
+    for (double& bound : query_bounds)
+    {
+        bound = 2 * query_generator.next_double() - 1;
+    }
+    start_time = omp_get_wtime();
+    for (std::size_t q = 0; q < query_count; ++q)
+    {
+        query_results[q] = table.integral(query_bounds[2 * q], query_bounds[2 * q + 1]);
+    }
+    double query_duration = omp_get_wtime() - start_time;
+    for (std::size_t q = 0; q < query_count; ++q)
+    {
+        double a = query_bounds[2 * q], b = query_bounds[2 * q + 1];
+        if (std::abs(query_results[q] - (b * b * b - a * a * a) / 3) > 1e-9)
+        {
+            std::cerr << "Prefix table query [" << a << ", " << b << "] returned " << query_results[q] << "\n";
+            return 1;
+        }
+    }
+
+    // Overwrite a range with 2 x^2 and compare a node-aligned query with a direct trapezoid sum
+    const std::size_t update_first = table_intervals / 3, update_count = 10000;
+    std::vector<double> new_samples(update_count);
+    for (std::size_t i = 0; i < update_count; ++i)
+    {
+        double x = -1 + (update_first + i) * table.step();
+        new_samples[i] = 2 * x * x;
+    }
+    start_time = omp_get_wtime();
+    table.update(update_first, new_samples.data(), update_count);
+    double update_duration = omp_get_wtime() - start_time;
+
+    std::size_t check_first = update_first - 100, check_last = update_first + update_count + 100;
+    double direct = 0;
+    for (std::size_t i = check_first; i < check_last; ++i)
+    {
+        direct += 0.5 * table.step() * (table.sample(i) + table.sample(i + 1));
+    }
+    double updated = table.integral(-1 + check_first * table.step(), -1 + check_last * table.step());
+    if (std::abs(updated - direct) > 1e-9)
+    {
+        std::cerr << "Prefix table update failed: " << updated << " vs " << direct << "\n";
+        return 1;
+    }
+
+    std::cout << "Prefix table: " << query_duration / query_count * 1e9 << " ns per query, update of " << update_count << " samples = " << update_duration * 1e6 << " us"
+        << ", full serial sweep = " << serial_duration * 1e6 << " us\n";
+
+    // Multi-dimensional Monte Carlo: fixed sample count for the scaling sweep
+    // (speedups relative to the same method at T = 1), then early stopping at a target error
+    const std::size_t monte_carlo_dims = 8;
+    const std::size_t monte_carlo_samples = std::size_t(1) << 22;
+    std::vector<double> unit_lower(monte_carlo_dims, 0.0), unit_upper(monte_carlo_dims, 1.0);
+    double monte_carlo_base = 0, quasi_monte_carlo_base = 0;
+    for (std::size_t threads = 1; threads <= std::thread::hardware_concurrency(); ++threads)
+    {
+        omp_set_num_threads(threads);
+        start_time = omp_get_wtime();
+        monte_carlo_result mc = integral_monte_carlo(sine_product_function(), unit_lower, unit_upper, 0, monte_carlo_samples, 42);
+        double mc_duration = omp_get_wtime() - start_time;
+
+        start_time = omp_get_wtime();
+        monte_carlo_result qmc = integral_quasi_monte_carlo(sine_product_function(), unit_lower, unit_upper, 0, monte_carlo_samples, 42);
+        double qmc_duration = omp_get_wtime() - start_time;
+
+        if (std::abs(mc.value - 1) > 5 * mc.error || std::abs(qmc.value - 1) > 5 * qmc.error + 1e-6)
+        {
+            std::cerr << "Monte Carlo failed: " << mc.value << " +- " << mc.error << ", " << qmc.value << " +- " << qmc.error << "\n";
+            return 1;
+        }
+        if (threads == 1)
+        {
+            monte_carlo_base = mc_duration;
+            quasi_monte_carlo_base = qmc_duration;
+        }
+
+        std::cout << "Monte Carlo " << monte_carlo_dims << "D: Threads = " << threads << ", Result = " << mc.value << " +- " << mc.error
+            << ", Samples/s per core = " << mc.samples / mc_duration / threads
+            << "; QMC Result = " << qmc.value << " +- " << qmc.error
+            << ", Samples/s per core = " << qmc.samples / qmc_duration / threads << "\n";
+        file << "monte_carlo," << threads << "," << mc_duration << "," << (monte_carlo_base / mc_duration) << "\n";
+        file << "quasi_monte_carlo," << threads << "," << qmc_duration << "," << (quasi_monte_carlo_base / qmc_duration) << "\n";
+    }
+
+    const double target_error = 1e-3;
+    monte_carlo_result mc_stop = integral_monte_carlo(sine_product_function(), unit_lower, unit_upper, target_error, monte_carlo_samples * 16, 7);
+    monte_carlo_result qmc_stop = integral_quasi_monte_carlo(sine_product_function(), unit_lower, unit_upper, target_error, monte_carlo_samples * 16, 7);
+    std::cout << "Target error " << target_error << ": Monte Carlo used " << mc_stop.samples << " samples (" << mc_stop.value << " +- " << mc_stop.error
+        << "), QMC used " << qmc_stop.samples << " samples (" << qmc_stop.value << " +- " << qmc_stop.error << ")\n";
+
     file.close();
     return 0;
 }
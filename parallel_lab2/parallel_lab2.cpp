@@ -3,12 +3,24 @@
 #include <fstream>
 #include <iostream>
 #include <immintrin.h>
+#include <memory>
+#include <omp.h>
+#include <string>
+#include <thread>
 #include <vector>
+#include "../common/aligned_buffer.h"
+#include "../common/cpu_dispatch.h"
+#include "../common/tlb_counter.h"
 
 
 #define COLUMNS 2048 * 2
 #define ROWS 2048 * 2
 
+// Result arrays at least this large are written with non-temporal stores
+const size_t STREAMING_THRESHOLD = 8 * 1024 * 1024;
+// How far ahead of the current element the inputs are prefetched
+const size_t PREFETCH_DISTANCE = 512;
+
 void matrix_addition(double* result, const double* mat1, const double* mat2, size_t num_cols, size_t num_rows)
 {
     for (size_t i = 0; i < num_cols * num_rows; ++i)
@@ -17,15 +29,418 @@ void matrix_addition(double* result, const double* mat1, const double* mat2, siz
     }
 }
 
-void matrix_addition_avx(double* result, const double* mat1, const double* mat2, size_t num_cols, size_t num_rows)
+TARGET_SSE2 void matrix_addition_sse2(double* result, const double* mat1, const double* mat2, size_t num_cols, size_t num_rows)
+{
+    size_t count = num_cols * num_rows;
+    for (size_t i = 0; i < count / 2; ++i)
+    {
+        __m128d sum = _mm_add_pd(_mm_loadu_pd(&mat1[i * 2]), _mm_loadu_pd(&mat2[i * 2]));
+        _mm_storeu_pd(&result[i * 2], sum);
+    }
+    for (size_t i = count / 2 * 2; i < count; ++i)
+    {
+        result[i] = mat1[i] + mat2[i];
+    }
+}
+
+TARGET_AVX2 void matrix_addition_avx(double* result, const double* mat1, const double* mat2, size_t num_cols, size_t num_rows)
 {
-    for (size_t i = 0; i < num_cols * num_rows / 4; ++i)
+    size_t count = num_cols * num_rows;
+    for (size_t i = 0; i < count / 4; ++i)
     {
         __m256d vec1 = _mm256_loadu_pd(&mat1[i * 4]);
         __m256d vec2 = _mm256_loadu_pd(&mat2[i * 4]);
         __m256d sum = _mm256_add_pd(vec1, vec2);
         _mm256_storeu_pd(&result[i * 4], sum);
     }
+    for (size_t i = count / 4 * 4; i < count; ++i)
+    {
+        result[i] = mat1[i] + mat2[i];
+    }
+}
+
+TARGET_AVX512 void matrix_addition_avx512(double* result, const double* mat1, const double* mat2, size_t num_cols, size_t num_rows)
+{
+    size_t count = num_cols * num_rows;
+    for (size_t i = 0; i < count / 8; ++i)
+    {
+        __m512d sum = _mm512_add_pd(_mm512_loadu_pd(&mat1[i * 8]), _mm512_loadu_pd(&mat2[i * 8]));
+        _mm512_storeu_pd(&result[i * 8], sum);
+    }
+    for (size_t i = count / 8 * 8; i < count; ++i)
+    {
+        result[i] = mat1[i] + mat2[i];
+    }
+}
+
+// All three matrices must be 32-byte aligned, e.g. aligned_vector storage
+TARGET_AVX2 void matrix_addition_avx_aligned(double* result, const double* mat1, const double* mat2, size_t num_cols, size_t num_rows)
+{
+    size_t count = num_cols * num_rows;
+    for (size_t i = 0; i < count / 4; ++i)
+    {
+        __m256d sum = _mm256_add_pd(_mm256_load_pd(&mat1[i * 4]), _mm256_load_pd(&mat2[i * 4]));
+        _mm256_store_pd(&result[i * 4], sum);
+    }
+    for (size_t i = count / 4 * 4; i < count; ++i)
+    {
+        result[i] = mat1[i] + mat2[i];
+    }
+}
+
+typedef void (*matrix_addition_fn)(double*, const double*, const double*, size_t, size_t);
+
+matrix_addition_fn select_matrix_addition(simd_level level)
+{
+    switch (level)
+    {
+    case simd_level::avx512: return matrix_addition_avx512;
+    case simd_level::avx2: return matrix_addition_avx;
+    case simd_level::sse2: return matrix_addition_sse2;
+    default: return matrix_addition;
+    }
+}
+
+// Bound once at startup, like the other *_best kernels below; kernels that exist only for AVX2 fall back to scalar loops
+const simd_level SIMD = selected_simd_level();
+const matrix_addition_fn matrix_addition_best = select_matrix_addition(SIMD);
+
+void matrix_subtraction(double* result, const double* mat1, const double* mat2, size_t num_cols, size_t num_rows)
+{
+    for (size_t i = 0; i < num_cols * num_rows; ++i)
+    {
+        result[i] = mat1[i] - mat2[i];
+    }
+}
+
+TARGET_AVX2 void matrix_subtraction_avx(double* result, const double* mat1, const double* mat2, size_t num_cols, size_t num_rows)
+{
+    size_t count = num_cols * num_rows;
+    for (size_t i = 0; i < count / 4; ++i)
+    {
+        __m256d vec1 = _mm256_loadu_pd(&mat1[i * 4]);
+        __m256d vec2 = _mm256_loadu_pd(&mat2[i * 4]);
+        _mm256_storeu_pd(&result[i * 4], _mm256_sub_pd(vec1, vec2));
+    }
+    for (size_t i = count / 4 * 4; i < count; ++i)
+    {
+        result[i] = mat1[i] - mat2[i];
+    }
+}
+
+// Elementwise (Hadamard) product
+void matrix_product(double* result, const double* mat1, const double* mat2, size_t num_cols, size_t num_rows)
+{
+    for (size_t i = 0; i < num_cols * num_rows; ++i)
+    {
+        result[i] = mat1[i] * mat2[i];
+    }
+}
+
+TARGET_AVX2 void matrix_product_avx(double* result, const double* mat1, const double* mat2, size_t num_cols, size_t num_rows)
+{
+    size_t count = num_cols * num_rows;
+    for (size_t i = 0; i < count / 4; ++i)
+    {
+        __m256d vec1 = _mm256_loadu_pd(&mat1[i * 4]);
+        __m256d vec2 = _mm256_loadu_pd(&mat2[i * 4]);
+        _mm256_storeu_pd(&result[i * 4], _mm256_mul_pd(vec1, vec2));
+    }
+    for (size_t i = count / 4 * 4; i < count; ++i)
+    {
+        result[i] = mat1[i] * mat2[i];
+    }
+}
+
+const matrix_addition_fn matrix_subtraction_best = SIMD >= simd_level::avx2 ? matrix_subtraction_avx : matrix_subtraction;
+const matrix_addition_fn matrix_product_best = SIMD >= simd_level::avx2 ? matrix_product_avx : matrix_product;
+
+
+struct buffer_deleter
+{
+    void operator()(double* pointer) const { release_buffer(pointer); }
+};
+
+struct thread_range
+{
+    size_t start;
+    size_t end;
+};
+
+// Contiguous slice of thread_id, rounded to whole 64-byte lines, so threads never share a line of
+// a buffer that is itself 64-byte aligned (allocate_buffer)
+thread_range thread_block(size_t count, size_t thread_count, size_t thread_id)
+{
+    size_t lines = (count + 7) / 8;
+    size_t start = std::min(lines * thread_id / thread_count * 8, count);
+    size_t end = std::min(lines * (thread_id + 1) / thread_count * 8, count);
+    return { start, end };
+}
+
+// Fills data with the same partitioning as matrix_addition_parallel, so on NUMA machines
+// each page is first touched, and therefore placed, by the thread that later streams it
+void first_touch_fill(double* data, double value, size_t count)
+{
+#pragma omp parallel
+    {
+        thread_range range = thread_block(count, omp_get_num_threads(), omp_get_thread_num());
+        std::fill(data + range.start, data + range.end, value);
+    }
+}
+
+TARGET_AVX2 void matrix_addition_range_avx(double* result, const double* mat1, const double* mat2, size_t start, size_t end, bool streaming)
+{
+    size_t i = start;
+
+    // Non-temporal stores need 32-byte aligned addresses
+    for (; streaming && i < end && reinterpret_cast<uintptr_t>(result + i) % 32 != 0; ++i)
+    {
+        result[i] = mat1[i] + mat2[i];
+    }
+    for (; i + 8 <= end; i += 8)
+    {
+        if (i + PREFETCH_DISTANCE < end)
+        {
+            _mm_prefetch(reinterpret_cast<const char*>(mat1 + i + PREFETCH_DISTANCE), _MM_HINT_T0);
+            _mm_prefetch(reinterpret_cast<const char*>(mat2 + i + PREFETCH_DISTANCE), _MM_HINT_T0);
+        }
+        __m256d sum1 = _mm256_add_pd(_mm256_loadu_pd(mat1 + i), _mm256_loadu_pd(mat2 + i));
+        __m256d sum2 = _mm256_add_pd(_mm256_loadu_pd(mat1 + i + 4), _mm256_loadu_pd(mat2 + i + 4));
+        if (streaming)
+        {
+            _mm256_stream_pd(result + i, sum1);
+            _mm256_stream_pd(result + i + 4, sum2);
+        }
+        else
+        {
+            _mm256_storeu_pd(result + i, sum1);
+            _mm256_storeu_pd(result + i + 4, sum2);
+        }
+    }
+    for (; i < end; ++i)
+    {
+        result[i] = mat1[i] + mat2[i];
+    }
+    if (streaming)
+    {
+        _mm_sfence();
+    }
+}
+
+// Elements [start, end) of result = mat1 + mat2; streaming only matters to the AVX2 kernel
+typedef void (*range_addition_fn)(double*, const double*, const double*, size_t, size_t, bool);
+
+void matrix_addition_range(double* result, const double* mat1, const double* mat2, size_t start, size_t end, bool)
+{
+    for (size_t i = start; i < end; ++i)
+    {
+        result[i] = mat1[i] + mat2[i];
+    }
+}
+
+const range_addition_fn matrix_addition_range_best = SIMD >= simd_level::avx2 ? matrix_addition_range_avx : matrix_addition_range;
+
+void matrix_addition_parallel(double* result, const double* mat1, const double* mat2, size_t num_cols, size_t num_rows)
+{
+    size_t count = num_cols * num_rows;
+    bool streaming = count * sizeof(double) >= STREAMING_THRESHOLD;
+
+#pragma omp parallel
+    {
+        thread_range range = thread_block(count, omp_get_num_threads(), omp_get_thread_num());
+        matrix_addition_range_best(result, mat1, mat2, range.start, range.end, streaming);
+    }
+}
+
+TARGET_AVX2 void stream_triad_range_avx(double* a, const double* b, const double* c, double scalar, size_t start, size_t end, bool streaming)
+{
+    size_t i = start;
+    __m256d factor = _mm256_set1_pd(scalar);
+
+    for (; streaming && i < end && reinterpret_cast<uintptr_t>(a + i) % 32 != 0; ++i)
+    {
+        a[i] = b[i] + scalar * c[i];
+    }
+    for (; i + 4 <= end; i += 4)
+    {
+        __m256d value = _mm256_add_pd(_mm256_loadu_pd(b + i), _mm256_mul_pd(factor, _mm256_loadu_pd(c + i)));
+        if (streaming)
+        {
+            _mm256_stream_pd(a + i, value);
+        }
+        else
+        {
+            _mm256_storeu_pd(a + i, value);
+        }
+    }
+    for (; i < end; ++i)
+    {
+        a[i] = b[i] + scalar * c[i];
+    }
+    if (streaming)
+    {
+        _mm_sfence();
+    }
+}
+
+typedef void (*range_triad_fn)(double*, const double*, const double*, double, size_t, size_t, bool);
+
+void stream_triad_range(double* a, const double* b, const double* c, double scalar, size_t start, size_t end, bool)
+{
+    for (size_t i = start; i < end; ++i)
+    {
+        a[i] = b[i] + scalar * c[i];
+    }
+}
+
+const range_triad_fn stream_triad_range_best = SIMD >= simd_level::avx2 ? stream_triad_range_avx : stream_triad_range;
+
+// STREAM triad a = b + s * c, the reference peak. It stores exactly like matrix_addition_parallel (non-temporal
+// above STREAMING_THRESHOLD with AVX2, ordinary stores otherwise), so both move the same bytes per element
+void stream_triad(double* a, const double* b, const double* c, double scalar, size_t count)
+{
+    bool streaming = count * sizeof(double) >= STREAMING_THRESHOLD;
+
+#pragma omp parallel
+    {
+        thread_range range = thread_block(count, omp_get_num_threads(), omp_get_thread_num());
+        stream_triad_range_best(a, b, c, scalar, range.start, range.end, streaming);
+    }
+}
+
+
+// Lazy elementwise expressions. Operators only build a tree of small nodes; evaluate() then makes
+// a single pass, asking the root for four elements at a time (packet) and for single elements
+// (at) in the tail, so no temporary matrix is ever written.
+template <class E>
+struct expression
+{
+    const E& self() const { return static_cast<const E&>(*this); }
+};
+
+struct matrix_operand : expression<matrix_operand>
+{
+    const double* data;
+
+    explicit matrix_operand(const double* data) : data(data) {}
+    double at(size_t i) const { return data[i]; }
+    TARGET_AVX2 __m256d packet(size_t i) const { return _mm256_loadu_pd(data + i); }
+};
+
+struct scalar_operand : expression<scalar_operand>
+{
+    double value;
+
+    explicit scalar_operand(double value) : value(value) {}
+    double at(size_t) const { return value; }
+    TARGET_AVX2 __m256d packet(size_t) const { return _mm256_set1_pd(value); }
+};
+
+struct add_op
+{
+    static double apply(double a, double b) { return a + b; }
+    TARGET_AVX2 static __m256d apply(__m256d a, __m256d b) { return _mm256_add_pd(a, b); }
+};
+
+struct sub_op
+{
+    static double apply(double a, double b) { return a - b; }
+    TARGET_AVX2 static __m256d apply(__m256d a, __m256d b) { return _mm256_sub_pd(a, b); }
+};
+
+struct mul_op
+{
+    static double apply(double a, double b) { return a * b; }
+    TARGET_AVX2 static __m256d apply(__m256d a, __m256d b) { return _mm256_mul_pd(a, b); }
+};
+
+struct min_op
+{
+    static double apply(double a, double b) { return b < a ? b : a; }
+    TARGET_AVX2 static __m256d apply(__m256d a, __m256d b) { return _mm256_min_pd(b, a); }
+};
+
+struct max_op
+{
+    static double apply(double a, double b) { return a < b ? b : a; }
+    TARGET_AVX2 static __m256d apply(__m256d a, __m256d b) { return _mm256_max_pd(b, a); }
+};
+
+template <class Op, class L, class R>
+struct binary_expression : expression<binary_expression<Op, L, R>>
+{
+    L left;
+    R right;
+
+    binary_expression(const L& left, const R& right) : left(left), right(right) {}
+    double at(size_t i) const { return Op::apply(left.at(i), right.at(i)); }
+    TARGET_AVX2 __m256d packet(size_t i) const { return Op::apply(left.packet(i), right.packet(i)); }
+};
+
+inline matrix_operand matrix(const double* data)
+{
+    return matrix_operand(data);
+}
+
+template <class L, class R>
+binary_expression<add_op, L, R> operator+(const expression<L>& left, const expression<R>& right)
+{
+    return { left.self(), right.self() };
+}
+
+template <class L, class R>
+binary_expression<sub_op, L, R> operator-(const expression<L>& left, const expression<R>& right)
+{
+    return { left.self(), right.self() };
+}
+
+template <class L, class R>
+binary_expression<mul_op, L, R> operator*(const expression<L>& left, const expression<R>& right)
+{
+    return { left.self(), right.self() };
+}
+
+template <class R>
+binary_expression<mul_op, scalar_operand, R> operator*(double left, const expression<R>& right)
+{
+    return { scalar_operand(left), right.self() };
+}
+
+template <class E>
+binary_expression<min_op, binary_expression<max_op, E, scalar_operand>, scalar_operand> clamp(const expression<E>& e, double low, double high)
+{
+    return { { e.self(), scalar_operand(low) }, scalar_operand(high) };
+}
+
+template <class E>
+TARGET_AVX2 void evaluate_avx(double* result, const E& e, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        _mm256_storeu_pd(result + i, e.packet(i));
+    }
+    for (; i < count; ++i)
+    {
+        result[i] = e.at(i);
+    }
+}
+
+template <class E>
+void evaluate_scalar(double* result, const E& e, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        result[i] = e.at(i);
+    }
+}
+
+// The kernel for each expression type is bound on its first evaluation
+template <class E>
+void evaluate(double* result, const expression<E>& expr, size_t count)
+{
+    static void (*const kernel)(double*, const E&, size_t) = SIMD >= simd_level::avx2 ? evaluate_avx<E> : evaluate_scalar<E>;
+    kernel(result, expr.self(), count);
 }
 
 
@@ -58,48 +473,220 @@ int main()
         };
 
 
-    matrix_addition_avx(result.data(), mat1.data(), mat2.data(), COLUMNS, ROWS);
-    for (std::size_t i = 0; i < COLUMNS * ROWS; ++i)
+    // Every variant the CPU supports is checked and timed, whatever SIMD_LEVEL selects
+    simd_level detected = detect_simd_level();
+    std::vector<simd_level> levels;
+    for (simd_level level : { simd_level::scalar, simd_level::sse2, simd_level::avx2, simd_level::avx512 })
     {
-        if (result[i] != 0.0)
+        if (level <= detected)
         {
-            std::cerr << "correct test failed\n";
-            return 1;
+            levels.push_back(level);
         }
     }
-    std::cout << "correct test passed\n";
+
+    for (simd_level level : levels)
+    {
+        std::fill(result.begin(), result.end(), -0.1);
+        select_matrix_addition(level)(result.data(), mat1.data(), mat2.data(), COLUMNS, ROWS);
+        for (std::size_t i = 0; i < COLUMNS * ROWS; ++i)
+        {
+            if (result[i] != 0.0)
+            {
+                std::cerr << "correct test failed for " << simd_level_name(level) << "\n";
+                return 1;
+            }
+        }
+    }
+    std::cout << "correct test passed, detected " << simd_level_name(detected) << ", bound " << simd_level_name(SIMD) << "\n";
 
     output_file << "T,Duration,speedup\n";
 
-    // Scalar 
     double scalar_avg_time = 0.0;
+    double avx_avg_time = 0.0;
+    for (simd_level level : levels)
+    {
+        matrix_addition_fn addition = level == SIMD ? matrix_addition_best : select_matrix_addition(level);
+        double avg_time = 0.0;
+        for (std::size_t i = 0; i < EPOCHS; ++i)
+        {
+            auto start_time = std::chrono::steady_clock::now();
+            addition(result.data(), mat1.data(), mat2.data(), COLUMNS, ROWS);
+            auto end_time = std::chrono::steady_clock::now();
+            avg_time += std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+        }
+        avg_time /= EPOCHS;
+        if (level == simd_level::scalar)
+        {
+            scalar_avg_time = avg_time;
+        }
+        if (level == SIMD)
+        {
+            avx_avg_time = avg_time;
+        }
+
+        std::cout << simd_level_name(level) << " addition: " << avg_time << " ms, speedup = " << scalar_avg_time / avg_time << "\n";
+        output_file << simd_level_name(level) << "," << avg_time << "," << scalar_avg_time / avg_time << "\n";
+    }
+
+    // Fused expression a + b * c - d against the same expression as three chained passes of the bound kernels
+    std::vector<double> mat3(COLUMNS * ROWS, 2.0), mat4(COLUMNS * ROWS, 0.5), temp(COLUMNS * ROWS);
+
+    // Tail and clamp check on an element count that is not a multiple of 4
+    const size_t tail_count = 1027;
+    std::vector<double> tail_a(tail_count), tail_b(tail_count), tail_result(tail_count, 0.0);
+    for (size_t i = 0; i < tail_count; ++i)
+    {
+        tail_a[i] = 0.01 * static_cast<double>(i) - 5.0;
+        tail_b[i] = 0.5 + 0.001 * static_cast<double>(i);
+    }
+    evaluate(tail_result.data(), clamp(2.0 * (matrix(tail_a.data()) * matrix(tail_b.data())) - matrix(tail_b.data()), -1.0, 1.0), tail_count);
+    for (size_t i = 0; i < tail_count; ++i)
+    {
+        double expected = std::min(std::max(2.0 * (tail_a[i] * tail_b[i]) - tail_b[i], -1.0), 1.0);
+        if (tail_result[i] != expected)
+        {
+            std::cerr << "expression tail test failed\n";
+            return 1;
+        }
+    }
+
+    double chained_avg_time = 0.0;
     for (std::size_t i = 0; i < EPOCHS; ++i)
     {
         auto start_time = std::chrono::steady_clock::now();
-        matrix_addition(result.data(), mat1.data(), mat2.data(), COLUMNS, ROWS);
+        matrix_product_best(temp.data(), mat2.data(), mat3.data(), COLUMNS, ROWS);
+        matrix_addition_best(temp.data(), mat1.data(), temp.data(), COLUMNS, ROWS);
+        matrix_subtraction_best(result.data(), temp.data(), mat4.data(), COLUMNS, ROWS);
         auto end_time = std::chrono::steady_clock::now();
-        scalar_avg_time += std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+        chained_avg_time += std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
     }
-    scalar_avg_time /= EPOCHS;
-
-    std::cout << "scalar addition: " << scalar_avg_time << " ms, speedup = 1.0\n";
-    output_file << "scalar," << scalar_avg_time << ",1.0\n";
+    chained_avg_time /= EPOCHS;
 
-    // AVX 
-    double avx_avg_time = 0.0;
+    double fused_avg_time = 0.0;
     for (std::size_t i = 0; i < EPOCHS; ++i)
     {
         auto start_time = std::chrono::steady_clock::now();
-        matrix_addition_avx(result.data(), mat1.data(), mat2.data(), COLUMNS, ROWS);
+        evaluate(temp.data(), matrix(mat1.data()) + matrix(mat2.data()) * matrix(mat3.data()) - matrix(mat4.data()), COLUMNS * ROWS);
         auto end_time = std::chrono::steady_clock::now();
-        avx_avg_time += std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+        fused_avg_time += std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
     }
-    avx_avg_time /= EPOCHS;
+    fused_avg_time /= EPOCHS;
 
-    std::cout << "AVX addition: " << avx_avg_time << " ms, speedup = " << scalar_avg_time / avx_avg_time << "\n";
-    output_file << "AVX," << avx_avg_time << "," << scalar_avg_time / avx_avg_time << "\n";
+    if (!std::equal(result.begin(), result.end(), temp.begin()))
+    {
+        std::cerr << "fused expression test failed\n";
+        return 1;
+    }
+
+    std::cout << "chained a + b * c - d: " << chained_avg_time << " ms, speedup = 1.0\n";
+    output_file << "chained," << chained_avg_time << ",1.0\n";
+    std::cout << "fused a + b * c - d: " << fused_avg_time << " ms, speedup = " << chained_avg_time / fused_avg_time << "\n";
+    output_file << "fused," << fused_avg_time << "," << chained_avg_time / fused_avg_time << "\n";
+
+    // Aligned AVX2 addition on aligned_vector storage with each page mode, against the unaligned
+    // kernel on std::vector. dTLB misses are counted where perf events are available.
+    if (SIMD >= simd_level::avx2)
+    {
+        tlb_miss_counter tlb_counter;
+        auto measure = [&](matrix_addition_fn addition, double* out, const double* in1, const double* in2, long long& tlb_misses)
+            {
+                double avg_time = 0.0;
+                tlb_counter.start();
+                for (std::size_t i = 0; i < EPOCHS; ++i)
+                {
+                    auto start_time = std::chrono::steady_clock::now();
+                    addition(out, in1, in2, COLUMNS, ROWS);
+                    auto end_time = std::chrono::steady_clock::now();
+                    avg_time += std::chrono::duration<double, std::milli>(end_time - start_time).count();
+                }
+                long long misses = tlb_counter.stop();
+                tlb_misses = misses < 0 ? -1 : misses / static_cast<long long>(EPOCHS);
+                return avg_time / EPOCHS;
+            };
+        auto misses_text = [](long long misses) { return misses < 0 ? std::string("n/a") : std::to_string(misses); };
+
+        long long vector_misses = 0;
+        double vector_time = measure(matrix_addition_avx, result.data(), mat1.data(), mat2.data(), vector_misses);
+        std::cout << "unaligned AVX2 addition, std::vector: " << vector_time << " ms, dTLB misses = " << misses_text(vector_misses) << "\n";
+        output_file << "std::vector," << vector_time << ",1.0\n";
+
+        for (page_mode mode : { page_mode::normal, page_mode::transparent_huge, page_mode::explicit_huge })
+        {
+            aligned_allocator<double> allocator(mode);
+            aligned_vector<double> aligned1(COLUMNS * ROWS, 1.0, allocator), aligned2(COLUMNS * ROWS, -1.0, allocator),
+                aligned_result(COLUMNS * ROWS, -0.1, allocator);
+            // A mode that fell back (no huge page pool, or no THP on Windows) would only repeat an earlier row
+            if (buffer_page_mode(aligned1.data()) != mode || buffer_page_mode(aligned2.data()) != mode || buffer_page_mode(aligned_result.data()) != mode)
+            {
+                std::cout << "aligned AVX2 addition, " << page_mode_name(mode) << ": unavailable, skipped\n";
+                continue;
+            }
+            long long aligned_misses = 0;
+            double aligned_time = measure(matrix_addition_avx_aligned, aligned_result.data(), aligned1.data(), aligned2.data(), aligned_misses);
+            if (std::any_of(aligned_result.begin(), aligned_result.end(), [](double x) { return x != 0.0; }))
+            {
+                std::cerr << "aligned addition test failed\n";
+                return 1;
+            }
+
+            page_mode actual = buffer_page_mode(aligned_result.data());
+            std::cout << "aligned AVX2 addition, " << page_mode_name(actual) << ": " << aligned_time << " ms, speedup = " << vector_time / aligned_time
+                << ", dTLB misses = " << misses_text(aligned_misses) << "\n";
+            output_file << "aligned " << page_mode_name(actual) << "," << aligned_time << "," << vector_time / aligned_time << "\n";
+        }
+    }
+
+    // Multithreaded streaming addition on first-touched buffers (scalar loop below AVX2). GB/s counts
+    // the two reads and one write per element, as STREAM does, and is compared with the best STREAM triad.
+    const size_t count = static_cast<size_t>(COLUMNS) * ROWS;
+    const double bytes = 3.0 * sizeof(double) * count;
+    // Cache-line aligned, so the line-rounded slices of thread_block never share a line
+    auto buffer = [count]() { return std::unique_ptr<double[], buffer_deleter>(static_cast<double*>(allocate_buffer(count * sizeof(double), page_mode::normal))); };
+    auto par1 = buffer(), par2 = buffer(), par_result = buffer();
+    first_touch_fill(par1.get(), 1.0, count);
+    first_touch_fill(par2.get(), -1.0, count);
+    first_touch_fill(par_result.get(), -0.1, count);
+
+    matrix_addition_parallel(par_result.get(), par1.get(), par2.get(), COLUMNS, ROWS);
+    if (std::any_of(par_result.get(), par_result.get() + count, [](double x) { return x != 0.0; }))
+    {
+        std::cerr << "parallel addition test failed\n";
+        return 1;
+    }
+
+    std::vector<double> parallel_times, triad_times;
+    double triad_peak = 0.0;
+    for (std::size_t threads = 1; threads <= std::thread::hardware_concurrency(); ++threads)
+    {
+        omp_set_num_threads(static_cast<int>(threads));
+        double parallel_time = 0.0, triad_time = 0.0;
+        for (std::size_t i = 0; i < EPOCHS; ++i)
+        {
+            auto start_time = std::chrono::steady_clock::now();
+            matrix_addition_parallel(par_result.get(), par1.get(), par2.get(), COLUMNS, ROWS);
+            auto end_time = std::chrono::steady_clock::now();
+            parallel_time += std::chrono::duration<double, std::milli>(end_time - start_time).count();
+
+            start_time = std::chrono::steady_clock::now();
+            stream_triad(par_result.get(), par1.get(), par2.get(), 3.0, count);
+            end_time = std::chrono::steady_clock::now();
+            triad_time += std::chrono::duration<double, std::milli>(end_time - start_time).count();
+        }
+        parallel_times.push_back(parallel_time / EPOCHS);
+        triad_times.push_back(triad_time / EPOCHS);
+        triad_peak = std::max(triad_peak, bytes / (triad_time / EPOCHS) / 1e6);
+    }
+
+    for (std::size_t threads = 1; threads <= parallel_times.size(); ++threads)
+    {
+        double parallel_time = parallel_times[threads - 1];
+        double bandwidth = bytes / parallel_time / 1e6;
+        std::cout << "parallel addition: Threads = " << threads << ", " << parallel_time << " ms, speedup over " << simd_level_name(SIMD) << " = " << avx_avg_time / parallel_time
+            << ", " << bandwidth << " GB/s (" << 100.0 * bandwidth / triad_peak << "% of STREAM triad peak " << triad_peak << " GB/s, "
+            << "triad here " << bytes / triad_times[threads - 1] / 1e6 << " GB/s)\n";
+        output_file << threads << "," << parallel_time << "," << avx_avg_time / parallel_time << "\n";
+    }
 
-  
     output_file.close();
     
     return 0;
@@ -1,11 +1,26 @@
 ﻿#include <cassert>
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <functional>
 #include <immintrin.h>
 #include <iostream>
+#include <mutex>
+#include <numeric>
 #include <random>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
+#include "../common/aligned_buffer.h"
+#include "../common/cpu_dispatch.h"
+#include "../common/tlb_counter.h"
 
 
 using namespace std;
@@ -31,26 +46,1522 @@ void multiply_scalar(double* A, size_t colsA, size_t rowsA,
 }
 
 
-void multiply_avx(double* A, size_t colsA, size_t rowsA,
+TARGET_SSE2 void multiply_sse2(double* A, size_t colsA, size_t rowsA,
     const double* B, size_t colsB, size_t rowsB,
     const double* C, size_t colsC, size_t rowsC)
 {
     assert(colsB == rowsC && colsA == colsC && rowsA == rowsB);
 
+    for (size_t rowBlock = 0; rowBlock < rowsB / 2; ++rowBlock)
+    {
+        for (size_t col = 0; col < colsC; ++col)
+        {
+            __m128d sum = _mm_setzero_pd();
+            for (size_t k = 0; k < rowsC; ++k)
+            {
+                __m128d bVec = _mm_loadu_pd(B + k * rowsB + rowBlock * 2);
+                __m128d cVal = _mm_set1_pd(C[col * rowsC + k]);
+                sum = _mm_add_pd(sum, _mm_mul_pd(bVec, cVal));
+            }
+            _mm_storeu_pd(A + col * rowsA + rowBlock * 2, sum);
+        }
+    }
+    for (size_t row = rowsB / 2 * 2; row < rowsB; ++row)
+    {
+        for (size_t col = 0; col < colsC; ++col)
+        {
+            double sum = 0;
+            for (size_t k = 0; k < rowsC; ++k)
+            {
+                sum += B[k * rowsB + row] * C[col * rowsC + k];
+            }
+            A[col * rowsA + row] = sum;
+        }
+    }
+}
+
+
+TARGET_AVX2 void multiply_avx(double* A, size_t colsA, size_t rowsA,
+    const double* B, size_t colsB, size_t rowsB,
+    const double* C, size_t colsC, size_t rowsC)
+{
+    assert(colsB == rowsC && colsA == colsC && rowsA == rowsB);
+
+    for (size_t rowBlock = 0; rowBlock < rowsB / 4; ++rowBlock)
+    {
+        for (size_t col = 0; col < colsC; ++col)
+        {
+            __m256d sum = _mm256_setzero_pd();
+            for (size_t k = 0; k < rowsC; ++k)
+            {
+                __m256d bVec = _mm256_loadu_pd(B + k * rowsB + rowBlock * 4);
+                __m256d cVal = _mm256_set1_pd(C[col * rowsC + k]);
+                sum = _mm256_fmadd_pd(bVec, cVal, sum);
+            }
+            _mm256_storeu_pd(A + col * rowsA + rowBlock * 4, sum);
+        }
+    }
+    for (size_t row = rowsB / 4 * 4; row < rowsB; ++row)
+    {
+        for (size_t col = 0; col < colsC; ++col)
+        {
+            double sum = 0;
+            for (size_t k = 0; k < rowsC; ++k)
+            {
+                sum += B[k * rowsB + row] * C[col * rowsC + k];
+            }
+            A[col * rowsA + row] = sum;
+        }
+    }
+}
+
+
+// multiply_avx with aligned loads and stores: A and B must be 32-byte aligned and rowsB a multiple of 4,
+// so that every column of A and B starts on a 32-byte boundary
+TARGET_AVX2 void multiply_avx_aligned(double* A, size_t colsA, size_t rowsA,
+    const double* B, size_t colsB, size_t rowsB,
+    const double* C, size_t colsC, size_t rowsC)
+{
+    assert(colsB == rowsC && colsA == colsC && rowsA == rowsB);
+    assert(rowsB % 4 == 0 && reinterpret_cast<uintptr_t>(A) % 32 == 0 && reinterpret_cast<uintptr_t>(B) % 32 == 0);
+
     for (size_t rowBlock = 0; rowBlock < rowsB / 4; ++rowBlock)
     {
         for (size_t col = 0; col < colsC; ++col)
         {
-            __m256d sum = _mm256_setzero_pd();
-            for (size_t k = 0; k < rowsC; ++k)
+            __m256d sum = _mm256_setzero_pd();
+            for (size_t k = 0; k < rowsC; ++k)
+            {
+                __m256d bVec = _mm256_load_pd(B + k * rowsB + rowBlock * 4);
+                __m256d cVal = _mm256_set1_pd(C[col * rowsC + k]);
+                sum = _mm256_fmadd_pd(bVec, cVal, sum);
+            }
+            _mm256_store_pd(A + col * rowsA + rowBlock * 4, sum);
+        }
+    }
+}
+
+
+TARGET_AVX512 void multiply_avx512(double* A, size_t colsA, size_t rowsA,
+    const double* B, size_t colsB, size_t rowsB,
+    const double* C, size_t colsC, size_t rowsC)
+{
+    assert(colsB == rowsC && colsA == colsC && rowsA == rowsB);
+
+    for (size_t rowBlock = 0; rowBlock < rowsB / 8; ++rowBlock)
+    {
+        for (size_t col = 0; col < colsC; ++col)
+        {
+            __m512d sum = _mm512_setzero_pd();
+            for (size_t k = 0; k < rowsC; ++k)
+            {
+                __m512d bVec = _mm512_loadu_pd(B + k * rowsB + rowBlock * 8);
+                __m512d cVal = _mm512_set1_pd(C[col * rowsC + k]);
+                sum = _mm512_fmadd_pd(bVec, cVal, sum);
+            }
+            _mm512_storeu_pd(A + col * rowsA + rowBlock * 8, sum);
+        }
+    }
+    for (size_t row = rowsB / 8 * 8; row < rowsB; ++row)
+    {
+        for (size_t col = 0; col < colsC; ++col)
+        {
+            double sum = 0;
+            for (size_t k = 0; k < rowsC; ++k)
+            {
+                sum += B[k * rowsB + row] * C[col * rowsC + k];
+            }
+            A[col * rowsA + row] = sum;
+        }
+    }
+}
+
+
+// Packed GEMM blocking for doubles: an MR x NR tile of C lives in accumulator registers, KC-deep packed
+// micro-panels stream from L1, an MC x KC block of the left operand stays in L2 and a KC x NC panel of the
+// right operand in L3
+const size_t GEMM_MR = 8;
+const size_t GEMM_NR = 6;
+const size_t GEMM_MC = 96;
+const size_t GEMM_KC = 256;
+const size_t GEMM_NC = 2040;
+
+// Packs an mc x kc block into MR-row micro-panels, each stored k-major and zero-padded to MR rows, converting
+// elements to the packed type. Element (i, p) of the block is a[i * rowStride + p * colStride], which covers
+// plain and transposed views.
+template <size_t MR, typename In, typename Packed>
+void gemm_pack_left(const In* a, size_t rowStride, size_t colStride, size_t mc, size_t kc, Packed* packed)
+{
+    for (size_t i0 = 0; i0 < mc; i0 += MR)
+    {
+        size_t rows = std::min(MR, mc - i0);
+        for (size_t p = 0; p < kc; ++p)
+        {
+            for (size_t i = 0; i < MR; ++i)
+            {
+                *packed++ = i < rows ? static_cast<Packed>(a[(i0 + i) * rowStride + p * colStride]) : Packed(0);
+            }
+        }
+    }
+}
+
+// Packs a kc x nc panel into NR-column micro-panels, each stored k-major and zero-padded to NR columns.
+// Element (p, j) of the panel is b[p * rowStride + j * colStride].
+template <size_t NR, typename In, typename Packed>
+void gemm_pack_right(const In* b, size_t rowStride, size_t colStride, size_t kc, size_t nc, Packed* packed)
+{
+    for (size_t j0 = 0; j0 < nc; j0 += NR)
+    {
+        size_t cols = std::min(NR, nc - j0);
+        for (size_t p = 0; p < kc; ++p)
+        {
+            for (size_t j = 0; j < NR; ++j)
+            {
+                *packed++ = j < cols ? static_cast<Packed>(b[p * rowStride + (j0 + j) * colStride]) : Packed(0);
+            }
+        }
+    }
+}
+
+// Scaling of a C tile update. Passed by reference, so that the scalars stay out of the registers the
+// accumulators need.
+template <typename T>
+struct gemm_scalars
+{
+    T alpha;
+    T beta;
+};
+
+// C tile (rows x cols, at most MR x NR) = alpha * packed a micro-panel * packed b micro-panel + beta * C tile;
+// with beta == 0 the tile is not read, as in BLAS.
+// The 8x6 tile takes 12 of the 16 ymm registers, leaving two for a and one for the broadcast of b;
+// the accumulators are spelled out so that no compiler keeps them in memory.
+TARGET_AVX2 void gemm_microkernel_avx2(size_t kc, const double* a, const double* b, double* c, size_t ldc,
+    size_t rows, size_t cols, const gemm_scalars<double>& scalars)
+{
+    __m256d c00 = _mm256_setzero_pd(), c10 = _mm256_setzero_pd();
+    __m256d c01 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c02 = _mm256_setzero_pd(), c12 = _mm256_setzero_pd();
+    __m256d c03 = _mm256_setzero_pd(), c13 = _mm256_setzero_pd();
+    __m256d c04 = _mm256_setzero_pd(), c14 = _mm256_setzero_pd();
+    __m256d c05 = _mm256_setzero_pd(), c15 = _mm256_setzero_pd();
+    for (size_t p = 0; p < kc; ++p)
+    {
+        __m256d a0 = _mm256_load_pd(a);
+        __m256d a1 = _mm256_load_pd(a + 4);
+        __m256d bj = _mm256_broadcast_sd(b);
+        c00 = _mm256_fmadd_pd(a0, bj, c00);
+        c10 = _mm256_fmadd_pd(a1, bj, c10);
+        bj = _mm256_broadcast_sd(b + 1);
+        c01 = _mm256_fmadd_pd(a0, bj, c01);
+        c11 = _mm256_fmadd_pd(a1, bj, c11);
+        bj = _mm256_broadcast_sd(b + 2);
+        c02 = _mm256_fmadd_pd(a0, bj, c02);
+        c12 = _mm256_fmadd_pd(a1, bj, c12);
+        bj = _mm256_broadcast_sd(b + 3);
+        c03 = _mm256_fmadd_pd(a0, bj, c03);
+        c13 = _mm256_fmadd_pd(a1, bj, c13);
+        bj = _mm256_broadcast_sd(b + 4);
+        c04 = _mm256_fmadd_pd(a0, bj, c04);
+        c14 = _mm256_fmadd_pd(a1, bj, c14);
+        bj = _mm256_broadcast_sd(b + 5);
+        c05 = _mm256_fmadd_pd(a0, bj, c05);
+        c15 = _mm256_fmadd_pd(a1, bj, c15);
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+
+    alignas(32) double tile[GEMM_MR * GEMM_NR];
+    _mm256_store_pd(tile + 0 * GEMM_MR, c00);
+    _mm256_store_pd(tile + 0 * GEMM_MR + 4, c10);
+    _mm256_store_pd(tile + 1 * GEMM_MR, c01);
+    _mm256_store_pd(tile + 1 * GEMM_MR + 4, c11);
+    _mm256_store_pd(tile + 2 * GEMM_MR, c02);
+    _mm256_store_pd(tile + 2 * GEMM_MR + 4, c12);
+    _mm256_store_pd(tile + 3 * GEMM_MR, c03);
+    _mm256_store_pd(tile + 3 * GEMM_MR + 4, c13);
+    _mm256_store_pd(tile + 4 * GEMM_MR, c04);
+    _mm256_store_pd(tile + 4 * GEMM_MR + 4, c14);
+    _mm256_store_pd(tile + 5 * GEMM_MR, c05);
+    _mm256_store_pd(tile + 5 * GEMM_MR + 4, c15);
+
+    double alpha = scalars.alpha, beta = scalars.beta;
+    if (rows == GEMM_MR && cols == GEMM_NR)
+    {
+        for (size_t j = 0; j < GEMM_NR; ++j)
+        {
+            double* column = c + j * ldc;
+            __m256d lo = _mm256_load_pd(tile + j * GEMM_MR);
+            __m256d hi = _mm256_load_pd(tile + j * GEMM_MR + 4);
+            if (alpha != 1.0)
+            {
+                lo = _mm256_mul_pd(lo, _mm256_set1_pd(alpha));
+                hi = _mm256_mul_pd(hi, _mm256_set1_pd(alpha));
+            }
+            if (beta != 0.0)
+            {
+                lo = _mm256_fmadd_pd(_mm256_loadu_pd(column), _mm256_set1_pd(beta), lo);
+                hi = _mm256_fmadd_pd(_mm256_loadu_pd(column + 4), _mm256_set1_pd(beta), hi);
+            }
+            _mm256_storeu_pd(column, lo);
+            _mm256_storeu_pd(column + 4, hi);
+        }
+        return;
+    }
+
+    // Edge tile: copy only the valid part
+    for (size_t j = 0; j < cols; ++j)
+    {
+        for (size_t i = 0; i < rows; ++i)
+        {
+            c[j * ldc + i] = alpha * tile[j * GEMM_MR + i] + (beta != 0.0 ? beta * c[j * ldc + i] : 0.0);
+        }
+    }
+}
+
+// C tile (rows x cols, at most MR x NR) = alpha * packed a micro-panel * packed b micro-panel + beta * C tile;
+// the float kernels keep the 8x6 shape in vectors of 8 (AVX2) or 16 (AVX-512) lanes, i.e. 16x6 and 32x6 tiles.
+TARGET_AVX2 void sgemm_microkernel_avx2(size_t kc, const float* a, const float* b, float* c, size_t ldc,
+    size_t rows, size_t cols, const gemm_scalars<float>& scalars)
+{
+    const size_t mr = 16;
+    __m256 c00 = _mm256_setzero_ps(), c10 = _mm256_setzero_ps();
+    __m256 c01 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c02 = _mm256_setzero_ps(), c12 = _mm256_setzero_ps();
+    __m256 c03 = _mm256_setzero_ps(), c13 = _mm256_setzero_ps();
+    __m256 c04 = _mm256_setzero_ps(), c14 = _mm256_setzero_ps();
+    __m256 c05 = _mm256_setzero_ps(), c15 = _mm256_setzero_ps();
+    for (size_t p = 0; p < kc; ++p)
+    {
+        __m256 a0 = _mm256_load_ps(a);
+        __m256 a1 = _mm256_load_ps(a + 8);
+        __m256 bj = _mm256_broadcast_ss(b);
+        c00 = _mm256_fmadd_ps(a0, bj, c00);
+        c10 = _mm256_fmadd_ps(a1, bj, c10);
+        bj = _mm256_broadcast_ss(b + 1);
+        c01 = _mm256_fmadd_ps(a0, bj, c01);
+        c11 = _mm256_fmadd_ps(a1, bj, c11);
+        bj = _mm256_broadcast_ss(b + 2);
+        c02 = _mm256_fmadd_ps(a0, bj, c02);
+        c12 = _mm256_fmadd_ps(a1, bj, c12);
+        bj = _mm256_broadcast_ss(b + 3);
+        c03 = _mm256_fmadd_ps(a0, bj, c03);
+        c13 = _mm256_fmadd_ps(a1, bj, c13);
+        bj = _mm256_broadcast_ss(b + 4);
+        c04 = _mm256_fmadd_ps(a0, bj, c04);
+        c14 = _mm256_fmadd_ps(a1, bj, c14);
+        bj = _mm256_broadcast_ss(b + 5);
+        c05 = _mm256_fmadd_ps(a0, bj, c05);
+        c15 = _mm256_fmadd_ps(a1, bj, c15);
+        a += mr;
+        b += GEMM_NR;
+    }
+
+    alignas(32) float tile[mr * GEMM_NR];
+    _mm256_store_ps(tile + 0 * mr, c00);
+    _mm256_store_ps(tile + 0 * mr + 8, c10);
+    _mm256_store_ps(tile + 1 * mr, c01);
+    _mm256_store_ps(tile + 1 * mr + 8, c11);
+    _mm256_store_ps(tile + 2 * mr, c02);
+    _mm256_store_ps(tile + 2 * mr + 8, c12);
+    _mm256_store_ps(tile + 3 * mr, c03);
+    _mm256_store_ps(tile + 3 * mr + 8, c13);
+    _mm256_store_ps(tile + 4 * mr, c04);
+    _mm256_store_ps(tile + 4 * mr + 8, c14);
+    _mm256_store_ps(tile + 5 * mr, c05);
+    _mm256_store_ps(tile + 5 * mr + 8, c15);
+
+    float alpha = scalars.alpha, beta = scalars.beta;
+    for (size_t j = 0; j < cols; ++j)
+    {
+        for (size_t i = 0; i < rows; ++i)
+        {
+            c[j * ldc + i] = alpha * tile[j * mr + i] + (beta != 0.0f ? beta * c[j * ldc + i] : 0.0f);
+        }
+    }
+}
+
+TARGET_AVX512 void sgemm_microkernel_avx512(size_t kc, const float* a, const float* b, float* c, size_t ldc,
+    size_t rows, size_t cols, const gemm_scalars<float>& scalars)
+{
+    const size_t mr = 32;
+    __m512 c00 = _mm512_setzero_ps(), c10 = _mm512_setzero_ps();
+    __m512 c01 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+    __m512 c02 = _mm512_setzero_ps(), c12 = _mm512_setzero_ps();
+    __m512 c03 = _mm512_setzero_ps(), c13 = _mm512_setzero_ps();
+    __m512 c04 = _mm512_setzero_ps(), c14 = _mm512_setzero_ps();
+    __m512 c05 = _mm512_setzero_ps(), c15 = _mm512_setzero_ps();
+    for (size_t p = 0; p < kc; ++p)
+    {
+        __m512 a0 = _mm512_load_ps(a);
+        __m512 a1 = _mm512_load_ps(a + 16);
+        __m512 bj = _mm512_set1_ps(b[0]);
+        c00 = _mm512_fmadd_ps(a0, bj, c00);
+        c10 = _mm512_fmadd_ps(a1, bj, c10);
+        bj = _mm512_set1_ps(b[1]);
+        c01 = _mm512_fmadd_ps(a0, bj, c01);
+        c11 = _mm512_fmadd_ps(a1, bj, c11);
+        bj = _mm512_set1_ps(b[2]);
+        c02 = _mm512_fmadd_ps(a0, bj, c02);
+        c12 = _mm512_fmadd_ps(a1, bj, c12);
+        bj = _mm512_set1_ps(b[3]);
+        c03 = _mm512_fmadd_ps(a0, bj, c03);
+        c13 = _mm512_fmadd_ps(a1, bj, c13);
+        bj = _mm512_set1_ps(b[4]);
+        c04 = _mm512_fmadd_ps(a0, bj, c04);
+        c14 = _mm512_fmadd_ps(a1, bj, c14);
+        bj = _mm512_set1_ps(b[5]);
+        c05 = _mm512_fmadd_ps(a0, bj, c05);
+        c15 = _mm512_fmadd_ps(a1, bj, c15);
+        a += mr;
+        b += GEMM_NR;
+    }
+
+    alignas(64) float tile[mr * GEMM_NR];
+    _mm512_store_ps(tile + 0 * mr, c00);
+    _mm512_store_ps(tile + 0 * mr + 16, c10);
+    _mm512_store_ps(tile + 1 * mr, c01);
+    _mm512_store_ps(tile + 1 * mr + 16, c11);
+    _mm512_store_ps(tile + 2 * mr, c02);
+    _mm512_store_ps(tile + 2 * mr + 16, c12);
+    _mm512_store_ps(tile + 3 * mr, c03);
+    _mm512_store_ps(tile + 3 * mr + 16, c13);
+    _mm512_store_ps(tile + 4 * mr, c04);
+    _mm512_store_ps(tile + 4 * mr + 16, c14);
+    _mm512_store_ps(tile + 5 * mr, c05);
+    _mm512_store_ps(tile + 5 * mr + 16, c15);
+
+    float alpha = scalars.alpha, beta = scalars.beta;
+    for (size_t j = 0; j < cols; ++j)
+    {
+        for (size_t i = 0; i < rows; ++i)
+        {
+            c[j * ldc + i] = alpha * tile[j * mr + i] + (beta != 0.0f ? beta * c[j * ldc + i] : 0.0f);
+        }
+    }
+}
+
+template <typename Packed, typename Out>
+using gemm_kernel_fn = void (*)(size_t, const Packed*, const Packed*, Out*, size_t, size_t, size_t, const gemm_scalars<Out>&);
+
+// c = alpha * op(a) * op(b) + beta * c for column-major storage with leading dimensions lda, ldb, ldc, where op(x) is x
+// or its transpose. op(a) is m x k, op(b) is k x n; transposes are taken by the packing, so views need no copies.
+// Operands are converted from In to the kernel's Packed type while packing, so one blocked loop nest serves double,
+// float and float-in/double-accumulate products.
+template <size_t MR, size_t NR, typename In, typename Packed, typename Out>
+void gemm_blocked(bool transA, bool transB, size_t m, size_t n, size_t k,
+    Out alpha, const In* a, size_t lda, const In* b, size_t ldb, Out beta, Out* c, size_t ldc, gemm_kernel_fn<Packed, Out> kernel)
+{
+    if (k == 0 || alpha == Out(0))
+    {
+        for (size_t j = 0; j < n; ++j)
+        {
+            for (size_t i = 0; i < m; ++i)
+            {
+                c[j * ldc + i] = beta == Out(0) ? Out(0) : beta * c[j * ldc + i];
+            }
+        }
+        return;
+    }
+
+    // Packing buffers are kept per thread and reused across calls
+    thread_local aligned_vector<Packed> packedLeft(GEMM_MC * GEMM_KC);
+    thread_local aligned_vector<Packed> packedRight((GEMM_NC + NR - 1) / NR * NR * GEMM_KC);
+    size_t aRowStride = transA ? lda : 1, aColStride = transA ? 1 : lda;
+    size_t bRowStride = transB ? ldb : 1, bColStride = transB ? 1 : ldb;
+    const gemm_scalars<Out> first = { alpha, beta }, later = { alpha, Out(1) };
+
+    for (size_t jc = 0; jc < n; jc += GEMM_NC)
+    {
+        size_t nc = std::min(GEMM_NC, n - jc);
+        for (size_t pc = 0; pc < k; pc += GEMM_KC)
+        {
+            size_t kc = std::min(GEMM_KC, k - pc);
+            gemm_pack_right<NR>(b + pc * bRowStride + jc * bColStride, bRowStride, bColStride, kc, nc, packedRight.data());
+            for (size_t ic = 0; ic < m; ic += GEMM_MC)
+            {
+                size_t mc = std::min(GEMM_MC, m - ic);
+                gemm_pack_left<MR>(a + ic * aRowStride + pc * aColStride, aRowStride, aColStride, mc, kc, packedLeft.data());
+                for (size_t jr = 0; jr < nc; jr += NR)
+                {
+                    for (size_t ir = 0; ir < mc; ir += MR)
+                    {
+                        kernel(kc, packedLeft.data() + ir * kc, packedRight.data() + jr * kc,
+                            c + (jc + jr) * ldc + ic + ir, ldc, std::min(MR, mc - ir), std::min(NR, nc - jr), pc > 0 ? later : first);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void dgemm_packed_avx2(bool transA, bool transB, size_t m, size_t n, size_t k,
+    double alpha, const double* a, size_t lda, const double* b, size_t ldb, double beta, double* c, size_t ldc)
+{
+    gemm_blocked<GEMM_MR, GEMM_NR>(transA, transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, gemm_microkernel_avx2);
+}
+
+void sgemm_packed_avx2(bool transA, bool transB, size_t m, size_t n, size_t k,
+    float alpha, const float* a, size_t lda, const float* b, size_t ldb, float beta, float* c, size_t ldc)
+{
+    gemm_blocked<16, GEMM_NR>(transA, transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, sgemm_microkernel_avx2);
+}
+
+void sgemm_packed_avx512(bool transA, bool transB, size_t m, size_t n, size_t k,
+    float alpha, const float* a, size_t lda, const float* b, size_t ldb, float beta, float* c, size_t ldc)
+{
+    gemm_blocked<32, GEMM_NR>(transA, transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, sgemm_microkernel_avx512);
+}
+
+// Float operands widened to double while packing, then the double kernel: half the operand memory of dgemm with
+// double accumulation and a double result. Accumulating in double caps the FMA width at 4 lanes on AVX2.
+void dsgemm_packed_avx2(bool transA, bool transB, size_t m, size_t n, size_t k,
+    double alpha, const float* a, size_t lda, const float* b, size_t ldb, double beta, double* c, size_t ldc)
+{
+    gemm_blocked<GEMM_MR, GEMM_NR, float, double, double>(transA, transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, gemm_microkernel_avx2);
+}
+
+// c (m x n) = a (m x k) * b (k x n), all column-major with leading dimensions lda, ldb, ldc
+TARGET_AVX2 void gemm_packed_avx2(size_t m, size_t n, size_t k, const double* a, size_t lda, const double* b, size_t ldb, double* c, size_t ldc)
+{
+    dgemm_packed_avx2(false, false, m, n, k, 1.0, a, lda, b, ldb, 0.0, c, ldc);
+}
+
+// Runs body(threadId) on threadCount threads, the calling thread being thread 0
+template <typename Body>
+void run_threads(size_t threadCount, const Body& body)
+{
+    vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; ++i)
+    {
+        threads.emplace_back(body, i);
+    }
+    body(0);
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+}
+
+// Reusable barrier for a fixed number of threads
+class thread_barrier
+{
+public:
+    explicit thread_barrier(size_t count) : count_(count), waiting_(0), generation_(0) {}
+
+    void arrive_and_wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        size_t generation = generation_;
+        if (++waiting_ == count_)
+        {
+            waiting_ = 0;
+            ++generation_;
+            condition_.notify_all();
+            return;
+        }
+        condition_.wait(lock, [&] { return generation != generation_; });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    size_t count_;
+    size_t waiting_;
+    size_t generation_;
+};
+
+struct index_range
+{
+    size_t start;
+    size_t end;
+};
+
+// Part part of count items split into parts nearly equal contiguous ranges
+index_range split_range(size_t count, size_t parts, size_t part)
+{
+    size_t base = count / parts, extra = count % parts;
+    size_t start = part * base + std::min(part, extra);
+    return { start, start + base + (part < extra ? 1 : 0) };
+}
+
+// gemm_packed_avx2 on threadCount threads. C is split into a rows x cols grid of 2-D tiles, one per thread, shaped
+// after C so that every thread packs as little of a as possible. Each KC x NC panel of b is packed once, cooperatively,
+// into a buffer all threads read, so memory traffic for b does not grow with the thread count.
+TARGET_AVX2 void gemm_packed_parallel_avx2(size_t m, size_t n, size_t k, const double* a, size_t lda, const double* b, size_t ldb,
+    double* c, size_t ldc, size_t threadCount)
+{
+    if (threadCount <= 1 || k == 0)
+    {
+        gemm_packed_avx2(m, n, k, a, lda, b, ldb, c, ldc);
+        return;
+    }
+
+    // The divisor of threadCount closest to sqrt(threadCount * m / n) makes the tiles closest to square
+    size_t gridRows = 1;
+    double idealRows = std::sqrt(static_cast<double>(threadCount) * m / std::max<size_t>(n, 1));
+    for (size_t rows = 1; rows <= threadCount; ++rows)
+    {
+        if (threadCount % rows == 0 && std::abs(rows - idealRows) < std::abs(gridRows - idealRows))
+        {
+            gridRows = rows;
+        }
+    }
+    size_t gridCols = threadCount / gridRows;
+
+    aligned_vector<double> packedRight((GEMM_NC + GEMM_NR - 1) / GEMM_NR * GEMM_NR * GEMM_KC);
+    thread_barrier barrier(threadCount);
+    const gemm_scalars<double> first = { 1.0, 0.0 }, later = { 1.0, 1.0 };
+
+    auto worker = [&](size_t threadId)
+        {
+            thread_local aligned_vector<double> packedLeft(GEMM_MC * GEMM_KC);
+            index_range rowTiles = split_range((m + GEMM_MR - 1) / GEMM_MR, gridRows, threadId / gridCols);
+            size_t rowStart = rowTiles.start * GEMM_MR, rowEnd = std::min(m, rowTiles.end * GEMM_MR);
+
+            for (size_t jc = 0; jc < n; jc += GEMM_NC)
+            {
+                size_t nc = std::min(GEMM_NC, n - jc);
+                size_t panels = (nc + GEMM_NR - 1) / GEMM_NR;
+                index_range colTiles = split_range(panels, gridCols, threadId % gridCols);
+
+                for (size_t pc = 0; pc < k; pc += GEMM_KC)
+                {
+                    size_t kc = std::min(GEMM_KC, k - pc);
+
+                    index_range packTiles = split_range(panels, threadCount, threadId);
+                    if (packTiles.start < packTiles.end)
+                    {
+                        size_t j0 = packTiles.start * GEMM_NR;
+                        gemm_pack_right<GEMM_NR>(b + (jc + j0) * ldb + pc, 1, ldb, kc, std::min(nc, packTiles.end * GEMM_NR) - j0, packedRight.data() + j0 * kc);
+                    }
+                    barrier.arrive_and_wait();
+
+                    for (size_t ic = rowStart; ic < rowEnd; ic += GEMM_MC)
+                    {
+                        size_t mc = std::min(GEMM_MC, rowEnd - ic);
+                        gemm_pack_left<GEMM_MR>(a + pc * lda + ic, 1, lda, mc, kc, packedLeft.data());
+                        for (size_t jr = colTiles.start * GEMM_NR; jr < std::min(nc, colTiles.end * GEMM_NR); jr += GEMM_NR)
+                        {
+                            for (size_t ir = 0; ir < mc; ir += GEMM_MR)
+                            {
+                                gemm_microkernel_avx2(kc, packedLeft.data() + ir * kc, packedRight.data() + jr * kc,
+                                    c + (jc + jr) * ldc + ic + ir, ldc, std::min(GEMM_MR, mc - ir), std::min(GEMM_NR, nc - jr), pc > 0 ? later : first);
+                            }
+                        }
+                    }
+                    // The panel is overwritten by the next iteration only after everyone is done with it
+                    barrier.arrive_and_wait();
+                }
+            }
+        };
+
+    run_threads(threadCount, worker);
+}
+
+// Packed multiply on threadCount threads with the lab signature: A = B * C
+TARGET_AVX2 void multiply_parallel(double* A, size_t colsA, size_t rowsA,
+    const double* B, size_t colsB, size_t rowsB,
+    const double* C, size_t colsC, size_t rowsC, size_t threadCount)
+{
+    assert(colsB == rowsC && colsA == colsC && rowsA == rowsB);
+
+    gemm_packed_parallel_avx2(rowsA, colsA, colsB, B, rowsB, C, rowsC, A, rowsA, threadCount);
+}
+
+// Packed, cache-blocked multiply with the lab signature: A = B * C
+TARGET_AVX2 void multiply_packed(double* A, size_t colsA, size_t rowsA,
+    const double* B, size_t colsB, size_t rowsB,
+    const double* C, size_t colsC, size_t rowsC)
+{
+    assert(colsB == rowsC && colsA == colsC && rowsA == rowsB);
+
+    gemm_packed_avx2(rowsA, colsA, colsB, B, rowsB, C, rowsC, A, rowsA);
+}
+
+
+// Rows [rowStart, rowEnd) of y = A * x for a rows x cols column-major A. Blocks of GEMV_ROW_BLOCK rows of y stay in L1
+// while four columns at a time stream through, so y is loaded and stored once per four columns.
+const size_t GEMV_ROW_BLOCK = 256;
+
+void gemv_rows_scalar(const double* A, size_t rows, size_t cols, const double* x, double* y, size_t rowStart, size_t rowEnd)
+{
+    std::fill(y + rowStart, y + rowEnd, 0.0);
+    for (size_t j = 0; j < cols; ++j)
+    {
+        for (size_t i = rowStart; i < rowEnd; ++i)
+        {
+            y[i] += A[j * rows + i] * x[j];
+        }
+    }
+}
+
+TARGET_AVX2 void gemv_rows_avx2(const double* A, size_t rows, size_t cols, const double* x, double* y, size_t rowStart, size_t rowEnd)
+{
+    std::fill(y + rowStart, y + rowEnd, 0.0);
+    for (size_t block = rowStart; block < rowEnd; block += GEMV_ROW_BLOCK)
+    {
+        size_t blockEnd = std::min(rowEnd, block + GEMV_ROW_BLOCK);
+        size_t vectorEnd = block + (blockEnd - block) / 4 * 4;
+        size_t j = 0;
+        for (; j + 4 <= cols; j += 4)
+        {
+            const double *a0 = A + j * rows, *a1 = a0 + rows, *a2 = a1 + rows, *a3 = a2 + rows;
+            __m256d x0 = _mm256_set1_pd(x[j]), x1 = _mm256_set1_pd(x[j + 1]), x2 = _mm256_set1_pd(x[j + 2]), x3 = _mm256_set1_pd(x[j + 3]);
+            for (size_t i = block; i < vectorEnd; i += 4)
+            {
+                __m256d sum = _mm256_loadu_pd(y + i);
+                sum = _mm256_fmadd_pd(_mm256_loadu_pd(a0 + i), x0, sum);
+                sum = _mm256_fmadd_pd(_mm256_loadu_pd(a1 + i), x1, sum);
+                sum = _mm256_fmadd_pd(_mm256_loadu_pd(a2 + i), x2, sum);
+                sum = _mm256_fmadd_pd(_mm256_loadu_pd(a3 + i), x3, sum);
+                _mm256_storeu_pd(y + i, sum);
+            }
+            for (size_t i = vectorEnd; i < blockEnd; ++i)
+            {
+                y[i] += a0[i] * x[j] + a1[i] * x[j + 1] + a2[i] * x[j + 2] + a3[i] * x[j + 3];
+            }
+        }
+        for (; j < cols; ++j)
+        {
+            for (size_t i = block; i < blockEnd; ++i)
+            {
+                y[i] += A[j * rows + i] * x[j];
+            }
+        }
+    }
+}
+
+// Compressed sparse rows: the nonzeros of row i are values[rowStart[i] .. rowStart[i + 1]) in columns colIndex[...].
+// Column indices are 32-bit so that AVX2 can gather x with them.
+struct csr_matrix
+{
+    size_t rows = 0;
+    size_t cols = 0;
+    vector<size_t> rowStart;
+    vector<std::int32_t> colIndex;
+    vector<double> values;
+};
+
+// CSR form of a rows x cols column-major dense matrix, keeping the nonzero entries
+csr_matrix csr_from_dense(const double* A, size_t rows, size_t cols)
+{
+    csr_matrix sparse;
+    sparse.rows = rows;
+    sparse.cols = cols;
+    sparse.rowStart.push_back(0);
+    for (size_t i = 0; i < rows; ++i)
+    {
+        for (size_t j = 0; j < cols; ++j)
+        {
+            if (A[j * rows + i] != 0.0)
+            {
+                sparse.colIndex.push_back(static_cast<std::int32_t>(j));
+                sparse.values.push_back(A[j * rows + i]);
+            }
+        }
+        sparse.rowStart.push_back(sparse.values.size());
+    }
+    return sparse;
+}
+
+void spmv_csr_rows_scalar(const csr_matrix& A, const double* x, double* y, size_t rowStart, size_t rowEnd)
+{
+    for (size_t i = rowStart; i < rowEnd; ++i)
+    {
+        double sum = 0;
+        for (size_t k = A.rowStart[i]; k < A.rowStart[i + 1]; ++k)
+        {
+            sum += A.values[k] * x[A.colIndex[k]];
+        }
+        y[i] = sum;
+    }
+}
+
+// x[columns[0..3]]. The masked gather with a zero source is the same instruction as _mm256_i32gather_pd, whose
+// deliberately undefined source GCC reports as -Wmaybe-uninitialized
+TARGET_AVX2 inline __m256d gather_avx2(const double* x, __m128i columns)
+{
+    return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), x, columns, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), 8);
+}
+
+TARGET_AVX2 void spmv_csr_rows_avx2(const csr_matrix& A, const double* x, double* y, size_t rowStart, size_t rowEnd)
+{
+    const double* values = A.values.data();
+    const std::int32_t* colIndex = A.colIndex.data();
+    for (size_t i = rowStart; i < rowEnd; ++i)
+    {
+        size_t k = A.rowStart[i], end = A.rowStart[i + 1];
+        __m256d sum = _mm256_setzero_pd();
+        for (; k + 4 <= end; k += 4)
+        {
+            __m128i columns = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colIndex + k));
+            sum = _mm256_fmadd_pd(_mm256_loadu_pd(values + k), gather_avx2(x, columns), sum);
+        }
+        __m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+        double total = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+        for (; k < end; ++k)
+        {
+            total += values[k] * x[colIndex[k]];
+        }
+        y[i] = total;
+    }
+}
+
+// SELL-C-sigma with C = 4, one AVX2 vector of doubles: within each window of sigma rows, rows are sorted by length,
+// then every chunk of C consecutive sorted rows is stored column by column, padded to its longest row. A chunk is
+// processed as C rows at once with no horizontal reduction; sorting keeps the padding small.
+const size_t SELL_CHUNK = 4;
+
+struct sell_matrix
+{
+    size_t rows = 0;
+    size_t cols = 0;
+    vector<size_t> chunkStart;
+    vector<size_t> chunkLength;
+    // Row of y stored at each sorted position; rows for the padding positions of the last chunk
+    vector<size_t> permutation;
+    aligned_vector<std::int32_t> colIndex;
+    aligned_vector<double> values;
+};
+
+sell_matrix sell_from_csr(const csr_matrix& A, size_t sigma)
+{
+    sell_matrix sell;
+    sell.rows = A.rows;
+    sell.cols = A.cols;
+    size_t chunks = (A.rows + SELL_CHUNK - 1) / SELL_CHUNK;
+    sell.permutation.resize(chunks * SELL_CHUNK, A.rows);
+    auto length = [&](size_t row) { return A.rowStart[row + 1] - A.rowStart[row]; };
+    for (size_t window = 0; window < A.rows; window += sigma)
+    {
+        size_t windowEnd = std::min(A.rows, window + sigma);
+        std::iota(sell.permutation.begin() + window, sell.permutation.begin() + windowEnd, window);
+        std::stable_sort(sell.permutation.begin() + window, sell.permutation.begin() + windowEnd,
+            [&](size_t left, size_t right) { return length(left) > length(right); });
+    }
+
+    size_t total = 0;
+    for (size_t chunk = 0; chunk < chunks; ++chunk)
+    {
+        size_t longest = 0;
+        for (size_t r = 0; r < SELL_CHUNK; ++r)
+        {
+            size_t row = sell.permutation[chunk * SELL_CHUNK + r];
+            longest = std::max(longest, row < A.rows ? length(row) : 0);
+        }
+        sell.chunkStart.push_back(total);
+        sell.chunkLength.push_back(longest);
+        total += longest * SELL_CHUNK;
+    }
+    sell.chunkStart.push_back(total);
+
+    sell.colIndex.assign(total, 0);
+    sell.values.assign(total, 0.0);
+    for (size_t chunk = 0; chunk < chunks; ++chunk)
+    {
+        for (size_t r = 0; r < SELL_CHUNK; ++r)
+        {
+            size_t row = sell.permutation[chunk * SELL_CHUNK + r];
+            for (size_t k = 0; row < A.rows && k < length(row); ++k)
+            {
+                sell.colIndex[sell.chunkStart[chunk] + k * SELL_CHUNK + r] = A.colIndex[A.rowStart[row] + k];
+                sell.values[sell.chunkStart[chunk] + k * SELL_CHUNK + r] = A.values[A.rowStart[row] + k];
+            }
+        }
+    }
+    return sell;
+}
+
+void spmv_sell_chunks_scalar(const sell_matrix& A, const double* x, double* y, size_t chunkStart, size_t chunkEnd)
+{
+    for (size_t chunk = chunkStart; chunk < chunkEnd; ++chunk)
+    {
+        double sum[SELL_CHUNK] = {};
+        for (size_t k = 0; k < A.chunkLength[chunk]; ++k)
+        {
+            for (size_t r = 0; r < SELL_CHUNK; ++r)
+            {
+                size_t index = A.chunkStart[chunk] + k * SELL_CHUNK + r;
+                sum[r] += A.values[index] * x[A.colIndex[index]];
+            }
+        }
+        for (size_t r = 0; r < SELL_CHUNK; ++r)
+        {
+            size_t row = A.permutation[chunk * SELL_CHUNK + r];
+            if (row < A.rows)
+            {
+                y[row] = sum[r];
+            }
+        }
+    }
+}
+
+TARGET_AVX2 void spmv_sell_chunks_avx2(const sell_matrix& A, const double* x, double* y, size_t chunkStart, size_t chunkEnd)
+{
+    for (size_t chunk = chunkStart; chunk < chunkEnd; ++chunk)
+    {
+        const double* values = A.values.data() + A.chunkStart[chunk];
+        const std::int32_t* colIndex = A.colIndex.data() + A.chunkStart[chunk];
+        __m256d sum = _mm256_setzero_pd();
+        for (size_t k = 0; k < A.chunkLength[chunk]; ++k)
+        {
+            __m128i columns = _mm_load_si128(reinterpret_cast<const __m128i*>(colIndex + k * SELL_CHUNK));
+            sum = _mm256_fmadd_pd(_mm256_load_pd(values + k * SELL_CHUNK), gather_avx2(x, columns), sum);
+        }
+        alignas(32) double result[SELL_CHUNK];
+        _mm256_store_pd(result, sum);
+        for (size_t r = 0; r < SELL_CHUNK; ++r)
+        {
+            size_t row = A.permutation[chunk * SELL_CHUNK + r];
+            if (row < A.rows)
+            {
+                y[row] = result[r];
+            }
+        }
+    }
+}
+
+// First item of the part-th of parts ranges that hold nearly equal work, where offsets[i] is the work before item i;
+// part == parts gives the item count, so that trailing items without work still belong to the last range
+size_t split_by_offsets(const vector<size_t>& offsets, size_t parts, size_t part)
+{
+    if (part == parts)
+    {
+        return offsets.size() - 1;
+    }
+    size_t target = offsets.back() / parts * part + std::min(offsets.back() % parts, part);
+    return std::lower_bound(offsets.begin(), offsets.end() - 1, target) - offsets.begin();
+}
+
+
+// Transposes work on TRANSPOSE_TILE x TRANSPOSE_TILE tiles, 32 KiB each, so that a source and a destination tile
+// stay in L2 and touch only TRANSPOSE_TILE pages each; within a tile, 4 x 4 blocks are transposed in registers
+const size_t TRANSPOSE_TILE = 64;
+
+// The four columns of a 4 x 4 block of doubles
+struct block_4x4
+{
+    __m256d c0, c1, c2, c3;
+};
+
+// Loads the 4 x 4 block at src (column stride lds) and returns its transpose
+TARGET_AVX2 inline block_4x4 load_transposed_4x4(const double* src, size_t lds)
+{
+    __m256d r0 = _mm256_loadu_pd(src), r1 = _mm256_loadu_pd(src + lds), r2 = _mm256_loadu_pd(src + 2 * lds), r3 = _mm256_loadu_pd(src + 3 * lds);
+    __m256d t0 = _mm256_unpacklo_pd(r0, r1), t1 = _mm256_unpackhi_pd(r0, r1);
+    __m256d t2 = _mm256_unpacklo_pd(r2, r3), t3 = _mm256_unpackhi_pd(r2, r3);
+    return { _mm256_permute2f128_pd(t0, t2, 0x20), _mm256_permute2f128_pd(t1, t3, 0x20),
+        _mm256_permute2f128_pd(t0, t2, 0x31), _mm256_permute2f128_pd(t1, t3, 0x31) };
+}
+
+TARGET_AVX2 inline void store_4x4(const block_4x4& block, double* dst, size_t ldd)
+{
+    _mm256_storeu_pd(dst, block.c0);
+    _mm256_storeu_pd(dst + ldd, block.c1);
+    _mm256_storeu_pd(dst + 2 * ldd, block.c2);
+    _mm256_storeu_pd(dst + 3 * ldd, block.c3);
+}
+
+// dst(j, i) = src(i, j) for rows [i0, i1) and columns [j0, j1) of column-major src
+void transpose_tile_scalar(const double* src, size_t lds, double* dst, size_t ldd, size_t i0, size_t i1, size_t j0, size_t j1)
+{
+    for (size_t i = i0; i < i1; ++i)
+    {
+        for (size_t j = j0; j < j1; ++j)
+        {
+            dst[i * ldd + j] = src[j * lds + i];
+        }
+    }
+}
+
+TARGET_AVX2 void transpose_tile_avx2(const double* src, size_t lds, double* dst, size_t ldd, size_t i0, size_t i1, size_t j0, size_t j1)
+{
+    size_t iVector = i0 + (i1 - i0) / 4 * 4, jVector = j0 + (j1 - j0) / 4 * 4;
+    for (size_t j = j0; j < jVector; j += 4)
+    {
+        for (size_t i = i0; i < iVector; i += 4)
+        {
+            store_4x4(load_transposed_4x4(src + j * lds + i, lds), dst + i * ldd + j, ldd);
+        }
+    }
+    transpose_tile_scalar(src, lds, dst, ldd, iVector, i1, j0, j1);
+    transpose_tile_scalar(src, lds, dst, ldd, i0, iVector, jVector, j1);
+}
+
+// In-place transpose of tiles: the tile at rows [i0, i1), columns [j0, j1) is exchanged with its mirror image, or
+// transposed within itself when it lies on the diagonal (i0 == j0)
+void transpose_swap_tile_scalar(double* a, size_t lda, size_t i0, size_t i1, size_t j0, size_t j1)
+{
+    for (size_t j = j0; j < j1; ++j)
+    {
+        for (size_t i = i0; i < (i0 == j0 ? j : i1); ++i)
+        {
+            std::swap(a[j * lda + i], a[i * lda + j]);
+        }
+    }
+}
+
+TARGET_AVX2 void transpose_swap_tile_avx2(double* a, size_t lda, size_t i0, size_t i1, size_t j0, size_t j1)
+{
+    bool diagonal = i0 == j0;
+    size_t iVector = i0 + (i1 - i0) / 4 * 4, jVector = j0 + (j1 - j0) / 4 * 4;
+    for (size_t j = j0; j < jVector; j += 4)
+    {
+        for (size_t i = i0; i < (diagonal ? j + 4 : iVector); i += 4)
+        {
+            block_4x4 lower = load_transposed_4x4(a + j * lda + i, lda);
+            if (diagonal && i == j)
+            {
+                store_4x4(lower, a + j * lda + i, lda);
+                continue;
+            }
+            block_4x4 upper = load_transposed_4x4(a + i * lda + j, lda);
+            store_4x4(lower, a + i * lda + j, lda);
+            store_4x4(upper, a + j * lda + i, lda);
+        }
+    }
+    // Rows and columns past the last whole block: the mirrored pairs not covered above
+    for (size_t j = j0; j < j1; ++j)
+    {
+        for (size_t i = (j < jVector ? iVector : i0); i < (diagonal ? j : i1); ++i)
+        {
+            std::swap(a[j * lda + i], a[i * lda + j]);
+        }
+    }
+}
+
+
+// out = x + y and out = x - y on h x h column-major blocks
+void block_add(size_t h, const double* x, size_t ldx, const double* y, size_t ldy, double* out, size_t ldo)
+{
+    for (size_t j = 0; j < h; ++j)
+    {
+        for (size_t i = 0; i < h; ++i)
+        {
+            out[j * ldo + i] = x[j * ldx + i] + y[j * ldy + i];
+        }
+    }
+}
+
+void block_sub(size_t h, const double* x, size_t ldx, const double* y, size_t ldy, double* out, size_t ldo)
+{
+    for (size_t j = 0; j < h; ++j)
+    {
+        for (size_t i = 0; i < h; ++i)
+        {
+            out[j * ldo + i] = x[j * ldx + i] - y[j * ldy + i];
+        }
+    }
+}
+
+// Scratch memory for strassen_multiply, grown on demand and kept across calls
+class strassen_workspace
+{
+public:
+    double* reserve(size_t count)
+    {
+        if (buffer_.size() < count)
+        {
+            buffer_ = aligned_vector<double>(count);
+        }
+        return buffer_.data();
+    }
+
+private:
+    aligned_vector<double> buffer_;
+};
+
+bool strassen_recurses(size_t n, size_t cutoff)
+{
+    return n > cutoff && n % 2 == 0;
+}
+
+// Doubles of scratch the sequential recursion needs below order n: two h x h temporaries per level
+size_t strassen_sequential_scratch(size_t n, size_t cutoff)
+{
+    return strassen_recurses(n, cutoff) ? 2 * (n / 2) * (n / 2) + strassen_sequential_scratch(n / 2, cutoff) : 0;
+}
+
+// c = a * b for n x n column-major blocks by Strassen-Winograd (7 products, 15 additions per level) with the
+// two-temporary schedule that keeps the intermediate sums in the quadrants of c. Orders at or below the cutoff,
+// and odd orders, go to the packed kernel.
+TARGET_AVX2 void strassen_sequential(size_t n, const double* a, size_t lda, const double* b, size_t ldb, double* c, size_t ldc,
+    size_t cutoff, double* scratch)
+{
+    if (!strassen_recurses(n, cutoff))
+    {
+        gemm_packed_avx2(n, n, n, a, lda, b, ldb, c, ldc);
+        return;
+    }
+
+    size_t h = n / 2;
+    const double *a11 = a, *a21 = a + h, *a12 = a + h * lda, *a22 = a + h * lda + h;
+    const double *b11 = b, *b21 = b + h, *b12 = b + h * ldb, *b22 = b + h * ldb + h;
+    double *c11 = c, *c21 = c + h, *c12 = c + h * ldc, *c22 = c + h * ldc + h;
+    double* x = scratch;
+    double* y = scratch + h * h;
+    double* deeper = scratch + 2 * h * h;
+
+    block_sub(h, a11, lda, a21, lda, x, h);                     // S3
+    block_sub(h, b22, ldb, b12, ldb, y, h);                     // T3
+    strassen_sequential(h, x, h, y, h, c21, ldc, cutoff, deeper); // P7
+    block_add(h, a21, lda, a22, lda, x, h);                     // S1
+    block_sub(h, b12, ldb, b11, ldb, y, h);                     // T1
+    strassen_sequential(h, x, h, y, h, c22, ldc, cutoff, deeper); // P5
+    block_sub(h, x, h, a11, lda, x, h);                         // S2
+    block_sub(h, b22, ldb, y, h, y, h);                         // T2
+    strassen_sequential(h, x, h, y, h, c12, ldc, cutoff, deeper); // P6
+    block_sub(h, a12, lda, x, h, x, h);                         // S4
+    strassen_sequential(h, x, h, b22, ldb, c11, ldc, cutoff, deeper); // P3
+    strassen_sequential(h, a11, lda, b11, ldb, x, h, cutoff, deeper); // P1
+    block_add(h, x, h, c12, ldc, c12, ldc);                     // U2 = P1 + P6
+    block_add(h, c12, ldc, c21, ldc, c21, ldc);                 // U3 = U2 + P7
+    block_add(h, c12, ldc, c22, ldc, c12, ldc);                 // U4 = U2 + P5
+    block_add(h, c21, ldc, c22, ldc, c22, ldc);                 // U7 = U3 + P5
+    block_add(h, c12, ldc, c11, ldc, c12, ldc);                 // U5 = U4 + P3
+    block_sub(h, y, h, b21, ldb, y, h);                         // T4
+    strassen_sequential(h, a22, lda, y, h, c11, ldc, cutoff, deeper); // P4
+    block_sub(h, c21, ldc, c11, ldc, c21, ldc);                 // U6 = U3 - P4
+    strassen_sequential(h, a12, lda, b21, ldb, c11, ldc, cutoff, deeper); // P2
+    block_add(h, x, h, c11, ldc, c11, ldc);                     // U1 = P1 + P2
+}
+
+// strassen_sequential whose top level forms all eight operand sums first and runs the seven products on up to
+// threadCount threads, each recursing sequentially in its own slice of the workspace
+TARGET_AVX2 void strassen_multiply(size_t n, const double* a, size_t lda, const double* b, size_t ldb, double* c, size_t ldc,
+    size_t cutoff, size_t threadCount, strassen_workspace& workspace)
+{
+    if (threadCount <= 1 || !strassen_recurses(n, cutoff))
+    {
+        strassen_sequential(n, a, lda, b, ldb, c, ldc, cutoff, workspace.reserve(std::max<size_t>(strassen_sequential_scratch(n, cutoff), 1)));
+        return;
+    }
+
+    size_t h = n / 2, hh = h * h;
+    size_t workers = std::min<size_t>(threadCount, 7);
+    size_t perWorker = strassen_sequential_scratch(h, cutoff);
+    double* scratch = workspace.reserve(15 * hh + workers * perWorker);
+    const double *a11 = a, *a21 = a + h, *a12 = a + h * lda, *a22 = a + h * lda + h;
+    const double *b11 = b, *b21 = b + h, *b12 = b + h * ldb, *b22 = b + h * ldb + h;
+    double *c11 = c, *c21 = c + h, *c12 = c + h * ldc, *c22 = c + h * ldc + h;
+    double *s1 = scratch, *s2 = s1 + hh, *s3 = s2 + hh, *s4 = s3 + hh;
+    double *t1 = s4 + hh, *t2 = t1 + hh, *t3 = t2 + hh, *t4 = t3 + hh;
+    double* p[7] = { t4 + hh, t4 + 2 * hh, t4 + 3 * hh, t4 + 4 * hh, t4 + 5 * hh, t4 + 6 * hh, t4 + 7 * hh };
+    double* deeper = t4 + 8 * hh;
+
+    block_add(h, a21, lda, a22, lda, s1, h);
+    block_sub(h, s1, h, a11, lda, s2, h);
+    block_sub(h, a11, lda, a21, lda, s3, h);
+    block_sub(h, a12, lda, s2, h, s4, h);
+    block_sub(h, b12, ldb, b11, ldb, t1, h);
+    block_sub(h, b22, ldb, t1, h, t2, h);
+    block_sub(h, b22, ldb, b12, ldb, t3, h);
+    block_sub(h, t2, h, b21, ldb, t4, h);
+
+    struct product { const double* x; size_t ldx; const double* y; size_t ldy; };
+    const product products[7] = {
+        { a11, lda, b11, ldb }, { a12, lda, b21, ldb }, { s4, h, b22, ldb }, { a22, lda, t4, h },
+        { s1, h, t1, h }, { s2, h, t2, h }, { s3, h, t3, h } };
+
+    std::atomic<size_t> next(0);
+    auto worker = [&](size_t workerId)
+        {
+            for (size_t i = next++; i < 7; i = next++)
+            {
+                strassen_sequential(h, products[i].x, products[i].ldx, products[i].y, products[i].ldy, p[i], h, cutoff, deeper + workerId * perWorker);
+            }
+        };
+    run_threads(workers, worker);
+
+    block_add(h, p[0], h, p[1], h, c11, ldc);   // U1 = P1 + P2
+    block_add(h, p[0], h, p[5], h, c12, ldc);   // U2 = P1 + P6
+    block_add(h, c12, ldc, p[6], h, c21, ldc);  // U3 = U2 + P7
+    block_add(h, c12, ldc, p[4], h, c12, ldc);  // U4 = U2 + P5
+    block_add(h, c12, ldc, p[2], h, c12, ldc);  // U5 = U4 + P3
+    block_add(h, c21, ldc, p[4], h, c22, ldc);  // U7 = U3 + P5
+    block_sub(h, c21, ldc, p[3], h, c21, ldc);  // U6 = U3 - P4
+}
+
+
+// Column piece of a small-matrix kernel: masked to the rows the mask selects, or a whole 4-row piece
+template <bool Masked>
+TARGET_AVX2 inline __m256d small_load_avx2(const double* p, __m256i mask)
+{
+    if constexpr (Masked)
+    {
+        return _mm256_maskload_pd(p, mask);
+    }
+    else
+    {
+        return _mm256_loadu_pd(p);
+    }
+}
+
+template <bool Masked>
+TARGET_AVX2 inline void small_store_avx2(double* p, __m256i mask, __m256d value)
+{
+    if constexpr (Masked)
+    {
+        _mm256_maskstore_pd(p, mask, value);
+    }
+    else
+    {
+        _mm256_storeu_pd(p, value);
+    }
+}
+
+// Rows i..i+3 of c = a * b for one N x N column-major matrix, N known at compile time: 4 x 4 blocks of c are
+// accumulated in four registers over fixed trip counts. Masked covers the last N % 4 rows with masked loads and
+// stores, which never touch memory past the matrix.
+template <size_t N, bool Masked>
+TARGET_AVX2 void multiply_small_rows_avx2(const double* a, const double* b, double* c, size_t i, __m256i mask)
+{
+    for (size_t j = 0; j + 4 <= N; j += 4)
+    {
+        __m256d c0 = _mm256_setzero_pd(), c1 = _mm256_setzero_pd(), c2 = _mm256_setzero_pd(), c3 = _mm256_setzero_pd();
+        for (size_t p = 0; p < N; ++p)
+        {
+            __m256d ap = small_load_avx2<Masked>(a + p * N + i, mask);
+            c0 = _mm256_fmadd_pd(ap, _mm256_broadcast_sd(b + j * N + p), c0);
+            c1 = _mm256_fmadd_pd(ap, _mm256_broadcast_sd(b + (j + 1) * N + p), c1);
+            c2 = _mm256_fmadd_pd(ap, _mm256_broadcast_sd(b + (j + 2) * N + p), c2);
+            c3 = _mm256_fmadd_pd(ap, _mm256_broadcast_sd(b + (j + 3) * N + p), c3);
+        }
+        small_store_avx2<Masked>(c + j * N + i, mask, c0);
+        small_store_avx2<Masked>(c + (j + 1) * N + i, mask, c1);
+        small_store_avx2<Masked>(c + (j + 2) * N + i, mask, c2);
+        small_store_avx2<Masked>(c + (j + 3) * N + i, mask, c3);
+    }
+    if constexpr (N % 4 != 0)
+    {
+        for (size_t j = N / 4 * 4; j < N; ++j)
+        {
+            __m256d c0 = _mm256_setzero_pd();
+            for (size_t p = 0; p < N; ++p)
+            {
+                __m256d ap = small_load_avx2<Masked>(a + p * N + i, mask);
+                c0 = _mm256_fmadd_pd(ap, _mm256_broadcast_sd(b + j * N + p), c0);
+            }
+            small_store_avx2<Masked>(c + j * N + i, mask, c0);
+        }
+    }
+}
+
+// c = a * b for one N x N column-major matrix, with no size checks and no runtime-sized loops
+template <size_t N>
+TARGET_AVX2 void multiply_small_avx2(const double* a, const double* b, double* c)
+{
+    const __m256i mask = _mm256_setr_epi64x(N % 4 > 0 ? -1 : 0, N % 4 > 1 ? -1 : 0, N % 4 > 2 ? -1 : 0, 0);
+    // Only instantiated where it runs, so orders below 4 get no unmasked kernel
+    if constexpr (N >= 4)
+    {
+        for (size_t i = 0; i + 4 <= N; i += 4)
+        {
+            multiply_small_rows_avx2<N, false>(a, b, c, i, mask);
+        }
+    }
+    if constexpr (N % 4 != 0)
+    {
+        multiply_small_rows_avx2<N, true>(a, b, c, N / 4 * 4, mask);
+    }
+}
+
+// Any order: for orders above SMALL_ORDER_MAX and below AVX2
+void multiply_small_generic(size_t n, const double* a, const double* b, double* c)
+{
+    for (size_t j = 0; j < n; ++j)
+    {
+        double* column = c + j * n;
+        std::fill(column, column + n, 0.0);
+        for (size_t p = 0; p < n; ++p)
+        {
+            double bp = b[j * n + p];
+            for (size_t i = 0; i < n; ++i)
+            {
+                column[i] += a[p * n + i] * bp;
+            }
+        }
+    }
+}
+
+typedef void (*small_multiply_fn)(const double*, const double*, double*);
+
+// Orders up to this one get a specialized kernel
+const size_t SMALL_ORDER_MAX = 32;
+
+template <size_t... Orders>
+std::array<small_multiply_fn, sizeof...(Orders)> small_multiply_table(std::index_sequence<Orders...>)
+{
+    return { { multiply_small_avx2<Orders + 1>... } };
+}
+
+const std::array<small_multiply_fn, SMALL_ORDER_MAX> SMALL_MULTIPLY = small_multiply_table(std::make_index_sequence<SMALL_ORDER_MAX>());
+
+// Specialized kernel for an order, or nullptr when there is none
+small_multiply_fn select_small_multiply(size_t order)
+{
+    return order >= 1 && order <= SMALL_ORDER_MAX ? SMALL_MULTIPLY[order - 1] : nullptr;
+}
+
+
+// Plain-loop GEMM with the same semantics as gemm_blocked, accumulating in Out: the reference for tests and the
+// path below AVX2
+template <typename In, typename Out>
+void gemm_reference(bool transA, bool transB, size_t m, size_t n, size_t k,
+    Out alpha, const In* a, size_t lda, const In* b, size_t ldb, Out beta, Out* c, size_t ldc)
+{
+    for (size_t j = 0; j < n; ++j)
+    {
+        for (size_t i = 0; i < m; ++i)
+        {
+            Out sum = 0;
+            for (size_t p = 0; p < k; ++p)
+            {
+                sum += Out(transA ? a[i * lda + p] : a[p * lda + i]) * Out(transB ? b[p * ldb + j] : b[j * ldb + p]);
+            }
+            c[j * ldc + i] = alpha * sum + (beta != Out(0) ? beta * c[j * ldc + i] : Out(0));
+        }
+    }
+}
+
+
+typedef void (*multiply_fn)(double*, size_t, size_t, const double*, size_t, size_t, const double*, size_t, size_t);
+
+multiply_fn select_multiply(simd_level level)
+{
+    switch (level)
+    {
+    case simd_level::avx512: return multiply_avx512;
+    case simd_level::avx2: return multiply_avx;
+    case simd_level::sse2: return multiply_sse2;
+    default: return multiply_scalar;
+    }
+}
+
+// Bound once at startup to the widest level the CPU (and SIMD_LEVEL) allows; from AVX2 on that is the packed GEMM
+const simd_level SIMD = selected_simd_level();
+const multiply_fn multiply_best = SIMD >= simd_level::avx2 ? multiply_packed : select_multiply(SIMD);
+
+// The BLAS-style, GEMV, SpMV and transpose kernels, bound the same way: AVX2 where available, plain loops below it
+typedef void (*dgemm_fn)(bool, bool, size_t, size_t, size_t, double, const double*, size_t, const double*, size_t, double, double*, size_t);
+typedef void (*sgemm_fn)(bool, bool, size_t, size_t, size_t, float, const float*, size_t, const float*, size_t, float, float*, size_t);
+typedef void (*dsgemm_fn)(bool, bool, size_t, size_t, size_t, double, const float*, size_t, const float*, size_t, double, double*, size_t);
+typedef void (*gemv_rows_fn)(const double*, size_t, size_t, const double*, double*, size_t, size_t);
+typedef void (*spmv_csr_rows_fn)(const csr_matrix&, const double*, double*, size_t, size_t);
+typedef void (*spmv_sell_chunks_fn)(const sell_matrix&, const double*, double*, size_t, size_t);
+typedef void (*transpose_tile_fn)(const double*, size_t, double*, size_t, size_t, size_t, size_t, size_t);
+typedef void (*transpose_swap_tile_fn)(double*, size_t, size_t, size_t, size_t, size_t);
+
+const dgemm_fn dgemm_best = SIMD >= simd_level::avx2 ? dgemm_packed_avx2 : gemm_reference<double, double>;
+const sgemm_fn sgemm_best = SIMD >= simd_level::avx512 ? sgemm_packed_avx512
+    : SIMD >= simd_level::avx2 ? sgemm_packed_avx2 : gemm_reference<float, float>;
+const dsgemm_fn dsgemm_best = SIMD >= simd_level::avx2 ? dsgemm_packed_avx2 : gemm_reference<float, double>;
+const gemv_rows_fn gemv_rows_best = SIMD >= simd_level::avx2 ? gemv_rows_avx2 : gemv_rows_scalar;
+const spmv_csr_rows_fn spmv_csr_rows_best = SIMD >= simd_level::avx2 ? spmv_csr_rows_avx2 : spmv_csr_rows_scalar;
+const spmv_sell_chunks_fn spmv_sell_chunks_best = SIMD >= simd_level::avx2 ? spmv_sell_chunks_avx2 : spmv_sell_chunks_scalar;
+const transpose_tile_fn transpose_tile_best = SIMD >= simd_level::avx2 ? transpose_tile_avx2 : transpose_tile_scalar;
+const transpose_swap_tile_fn transpose_swap_tile_best = SIMD >= simd_level::avx2 ? transpose_swap_tile_avx2 : transpose_swap_tile_scalar;
+
+
+// 'N' or 'n' for X, 'T', 't', 'C' or 'c' for X^T, as in BLAS
+bool blas_transposed(char trans)
+{
+    bool transposed = trans == 'T' || trans == 't' || trans == 'C' || trans == 'c';
+    assert(transposed || trans == 'N' || trans == 'n');
+    return transposed;
+}
+
+// BLAS-style entry point: C = alpha * op(A) * op(B) + beta * C, column-major, op(X) = X for 'N' and X^T for 'T' or 'C'.
+// op(A) is m x k and op(B) is k x n. Sub-blocks of larger matrices are passed as a pointer and the parent's leading
+// dimension. Row-major data is the transposed column-major matrix, so row-major C = A * B is dgemm('N', 'N', n, m, k, ...)
+// with the operands swapped: B first, then A.
+void dgemm(char transA, char transB, size_t m, size_t n, size_t k,
+    double alpha, const double* A, size_t lda, const double* B, size_t ldb, double beta, double* C, size_t ldc)
+{
+    bool tA = blas_transposed(transA), tB = blas_transposed(transB);
+    assert(lda >= std::max<size_t>(1, tA ? k : m) && ldb >= std::max<size_t>(1, tB ? n : k) && ldc >= std::max<size_t>(1, m));
+
+    dgemm_best(tA, tB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+// dgemm in single precision: 8 lanes per FMA with AVX2, 16 with AVX-512
+void sgemm(char transA, char transB, size_t m, size_t n, size_t k,
+    float alpha, const float* A, size_t lda, const float* B, size_t ldb, float beta, float* C, size_t ldc)
+{
+    bool tA = blas_transposed(transA), tB = blas_transposed(transB);
+    assert(lda >= std::max<size_t>(1, tA ? k : m) && ldb >= std::max<size_t>(1, tB ? n : k) && ldc >= std::max<size_t>(1, m));
+
+    sgemm_best(tA, tB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+// Mixed precision: float A and B, double accumulation, alpha, beta and C
+void dsgemm(char transA, char transB, size_t m, size_t n, size_t k,
+    double alpha, const float* A, size_t lda, const float* B, size_t ldb, double beta, double* C, size_t ldc)
+{
+    bool tA = blas_transposed(transA), tB = blas_transposed(transB);
+    assert(lda >= std::max<size_t>(1, tA ? k : m) && ldb >= std::max<size_t>(1, tB ? n : k) && ldc >= std::max<size_t>(1, m));
+
+    dsgemm_best(tA, tB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+
+// y = A * x for a rows x cols column-major A, rows split across threadCount threads
+void gemv(const double* A, size_t rows, size_t cols, const double* x, double* y, size_t threadCount)
+{
+    run_threads(threadCount, [&](size_t threadId)
+        {
+            // Ranges in whole vectors, so that threads never share a cache line of y unless rows is tiny
+            index_range range = split_range((rows + 7) / 8, threadCount, threadId);
+            size_t rowStart = std::min(rows, range.start * 8), rowEnd = std::min(rows, range.end * 8);
+            gemv_rows_best(A, rows, cols, x, y, rowStart, rowEnd);
+        });
+}
+
+// y = A * x, rows split so that every thread gets nearly the same number of nonzeros
+void spmv_csr(const csr_matrix& A, const double* x, double* y, size_t threadCount)
+{
+    run_threads(threadCount, [&](size_t threadId)
+        {
+            size_t rowStart = split_by_offsets(A.rowStart, threadCount, threadId);
+            size_t rowEnd = split_by_offsets(A.rowStart, threadCount, threadId + 1);
+            spmv_csr_rows_best(A, x, y, rowStart, rowEnd);
+        });
+}
+
+// y = A * x, chunks split so that every thread gets nearly the same number of stored (padded) entries
+void spmv_sell(const sell_matrix& A, const double* x, double* y, size_t threadCount)
+{
+    run_threads(threadCount, [&](size_t threadId)
+        {
+            size_t chunkStart = split_by_offsets(A.chunkStart, threadCount, threadId);
+            size_t chunkEnd = split_by_offsets(A.chunkStart, threadCount, threadId + 1);
+            spmv_sell_chunks_best(A, x, y, chunkStart, chunkEnd);
+        });
+}
+
+
+// dst = src^T for a rows x cols column-major src; dst is cols x rows column-major. Tiles are dealt out to
+// threadCount threads. Row-major rows x cols data is a column-major cols x rows matrix, so transpose(src, cols, rows,
+// dst) turns it into the column-major layout the kernels above take, and transpose(src, rows, cols, dst) turns
+// column-major results back into row-major.
+void transpose(const double* src, size_t rows, size_t cols, double* dst, size_t threadCount)
+{
+    size_t tileRows = (rows + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE, tileCols = (cols + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+    run_threads(threadCount, [&](size_t threadId)
+        {
+            index_range tiles = split_range(tileRows * tileCols, threadCount, threadId);
+            for (size_t tile = tiles.start; tile < tiles.end; ++tile)
             {
-                __m256d bVec = _mm256_loadu_pd(B + k * rowsB + rowBlock * 4);
-                __m256d cVal = _mm256_set1_pd(C[col * rowsC + k]);
-                sum = _mm256_fmadd_pd(bVec, cVal, sum);
+                size_t i0 = tile % tileRows * TRANSPOSE_TILE, j0 = tile / tileRows * TRANSPOSE_TILE;
+                size_t i1 = std::min(rows, i0 + TRANSPOSE_TILE), j1 = std::min(cols, j0 + TRANSPOSE_TILE);
+                transpose_tile_best(src, rows, dst, cols, i0, i1, j0, j1);
             }
-            _mm256_storeu_pd(A + col * rowsA + rowBlock * 4, sum);
-        }
+        });
+}
+
+// a = a^T for an n x n column-major matrix. Each tile on or above the diagonal is one unit of work, exchanged with
+// its mirror image below the diagonal; units are dealt out to threadCount threads.
+void transpose_in_place(double* a, size_t n, size_t threadCount)
+{
+    size_t tiles = (n + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+    run_threads(threadCount, [&](size_t threadId)
+        {
+            index_range pairs = split_range(tiles * (tiles + 1) / 2, threadCount, threadId);
+            // Walk the upper triangle column by column: column J holds J + 1 tiles
+            size_t J = 0, first = 0;
+            while (first + J + 1 <= pairs.start)
+            {
+                first += ++J;
+            }
+            for (size_t pair = pairs.start; pair < pairs.end; ++pair)
+            {
+                if (pair == first + J + 1)
+                {
+                    first += ++J;
+                }
+                size_t I = pair - first;
+                size_t i0 = I * TRANSPOSE_TILE, j0 = J * TRANSPOSE_TILE;
+                size_t i1 = std::min(n, i0 + TRANSPOSE_TILE), j1 = std::min(n, j0 + TRANSPOSE_TILE);
+                transpose_swap_tile_best(a, n, i0, i1, j0, j1);
+            }
+        });
+}
+
+
+// c[i] = a[i] * b[i] for count order x order column-major matrices stored back to back, split across threadCount
+// threads. The kernel is chosen once per batch, so per-matrix work is just the specialized multiply.
+void gemm_batched(size_t order, size_t count, const double* a, const double* b, double* c, size_t threadCount)
+{
+    size_t stride = order * order;
+    small_multiply_fn kernel = SIMD >= simd_level::avx2 ? select_small_multiply(order) : nullptr;
+    auto worker = [&](size_t threadId)
+        {
+            index_range range = split_range(count, threadCount, threadId);
+            for (size_t i = range.start; i < range.end; ++i)
+            {
+                if (kernel)
+                {
+                    kernel(a + i * stride, b + i * stride, c + i * stride);
+                }
+                else
+                {
+                    multiply_small_generic(order, a + i * stride, b + i * stride, c + i * stride);
+                }
+            }
+        };
+
+    run_threads(std::max<size_t>(1, std::min(threadCount, count)), worker);
+}
+
+
+// Single-core double-precision peak, measured with ten independent FMA chains: enough to cover
+// the FMA latency on both ports of current cores
+TARGET_AVX2 double measure_peak_gflops_avx2()
+{
+    const size_t iterations = 1 << 24;
+    const __m256d factor = _mm256_set1_pd(0.999999);
+    const __m256d addend = _mm256_set1_pd(1e-9);
+    __m256d x0 = _mm256_set1_pd(0.0), x1 = _mm256_set1_pd(1.0), x2 = _mm256_set1_pd(2.0), x3 = _mm256_set1_pd(3.0),
+        x4 = _mm256_set1_pd(4.0), x5 = _mm256_set1_pd(5.0), x6 = _mm256_set1_pd(6.0), x7 = _mm256_set1_pd(7.0),
+        x8 = _mm256_set1_pd(8.0), x9 = _mm256_set1_pd(9.0);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t it = 0; it < iterations; ++it)
+    {
+        x0 = _mm256_fmadd_pd(x0, factor, addend);
+        x1 = _mm256_fmadd_pd(x1, factor, addend);
+        x2 = _mm256_fmadd_pd(x2, factor, addend);
+        x3 = _mm256_fmadd_pd(x3, factor, addend);
+        x4 = _mm256_fmadd_pd(x4, factor, addend);
+        x5 = _mm256_fmadd_pd(x5, factor, addend);
+        x6 = _mm256_fmadd_pd(x6, factor, addend);
+        x7 = _mm256_fmadd_pd(x7, factor, addend);
+        x8 = _mm256_fmadd_pd(x8, factor, addend);
+        x9 = _mm256_fmadd_pd(x9, factor, addend);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    __m256d sum = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(x0, x1), _mm256_add_pd(x2, x3)),
+        _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(x4, x5), _mm256_add_pd(x6, x7)), _mm256_add_pd(x8, x9)));
+    volatile double sink = _mm256_cvtsd_f64(sum);
+    (void)sink;
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return iterations * 10.0 * 4 * 2 / seconds * 1e-9;
+}
+
+
+// Largest elementwise difference relative to the largest magnitude in expected
+double relative_error(const double* expected, const double* actual, std::size_t count)
+{
+    double max_difference = 0, max_value = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        max_difference = std::max(max_difference, std::abs(expected[i] - actual[i]));
+        max_value = std::max(max_value, std::abs(expected[i]));
     }
+    return max_value == 0 ? max_difference : max_difference / max_value;
 }
 
 
@@ -91,8 +1602,7 @@ int main()
 
     vector<double> A(matrixOrder * matrixOrder),
         C(matrixOrder * matrixOrder),
-        D(matrixOrder * matrixOrder),
-        E(matrixOrder * matrixOrder);
+        D(matrixOrder * matrixOrder);
     vector<double> B(matrixOrder * matrixOrder, 1.0);
     
 
@@ -102,52 +1612,670 @@ int main()
         A.data(), matrixOrder, matrixOrder,
         B.data(), matrixOrder, matrixOrder);
 
-    multiply_avx(D.data(), matrixOrder, matrixOrder,
+    // Every variant the CPU supports is checked and timed, whatever SIMD_LEVEL selects
+    simd_level detected = detect_simd_level();
+    vector<simd_level> levels;
+    for (simd_level level : { simd_level::scalar, simd_level::sse2, simd_level::avx2, simd_level::avx512 })
+    {
+        if (level <= detected)
+        {
+            levels.push_back(level);
+        }
+    }
+
+    for (simd_level level : levels)
+    {
+        select_multiply(level)(D.data(), matrixOrder, matrixOrder,
+            A.data(), matrixOrder, matrixOrder,
+            B.data(), matrixOrder, matrixOrder);
+        if (relative_error(C.data(), D.data(), matrixOrder * matrixOrder) > 1e-12)
+        {
+            std::cerr << "correct test failed for " << simd_level_name(level) << "\n";
+            output.close();
+            return 1;
+        }
+    }
+    // Every variant again on a rectangular product whose sizes are not multiples of any vector width or block
+    const std::size_t m = 203, n = 157, k = 301;
+    vector<double> left(m * k), right(k * n), expected(m * n), actual(m * n, -1.0);
+    std::default_random_engine generator;
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    for (double& x : left)
+    {
+        x = distribution(generator);
+    }
+    for (double& x : right)
+    {
+        x = distribution(generator);
+    }
+    multiply_scalar(expected.data(), n, m, left.data(), k, m, right.data(), n, k);
+    for (simd_level level : levels)
+    {
+        std::fill(actual.begin(), actual.end(), -1.0);
+        select_multiply(level)(actual.data(), n, m, left.data(), k, m, right.data(), n, k);
+        if (relative_error(expected.data(), actual.data(), m * n) > 1e-12)
+        {
+            std::cerr << "correct test failed for " << simd_level_name(level) << " on " << m << " x " << k << " x " << n << "\n";
+            output.close();
+            return 1;
+        }
+    }
+
+    // dgemm on views into larger matrices, with every transpose combination, alpha and beta; beta == 0 must ignore NaN in C
+    for (int variant = 0; variant < 8; ++variant)
+    {
+        bool tA = variant & 1, tB = variant & 2;
+        double alpha = 0.5, beta = variant & 4 ? 0.0 : -2.0;
+        const std::size_t lda = (tA ? k : m) + 5, ldb = (tB ? n : k) + 3, ldc = m + 7;
+        vector<double> a(lda * (tA ? m : k)), b(ldb * (tB ? k : n)), c(ldc * n), reference;
+        for (double& x : a)
+        {
+            x = distribution(generator);
+        }
+        for (double& x : b)
+        {
+            x = distribution(generator);
+        }
+        for (double& x : c)
+        {
+            x = beta == 0.0 ? std::nan("") : distribution(generator);
+        }
+        vector<double> initial = c;
+        reference = c;
+        gemm_reference(tA, tB, m, n, k, alpha, a.data() + 2, lda, b.data() + 1, ldb, beta, reference.data() + 3, ldc);
+        dgemm(tA ? 'T' : 'N', tB ? 'T' : 'N', m, n, k, alpha, a.data() + 2, lda, b.data() + 1, ldb, beta, c.data() + 3, ldc);
+        for (std::size_t j = 0; j < n; ++j)
+        {
+            // Padding rows of C outside the view must be left alone
+            if (std::memcmp(&c[j * ldc], &reference[j * ldc], 3 * sizeof(double)) != 0 ||
+                std::memcmp(&c[j * ldc + 3 + m], &reference[j * ldc + 3 + m], (ldc - 3 - m) * sizeof(double)) != 0 ||
+                relative_error(&reference[j * ldc + 3], &c[j * ldc + 3], m) > 1e-12)
+            {
+                std::cerr << "correct test failed for dgemm, trans " << tA << tB << ", beta " << beta << "\n";
+                output.close();
+                return 1;
+            }
+        }
+
+        // The same product in single and in mixed precision, against the double reference
+        vector<float> aSingle(a.begin(), a.end()), bSingle(b.begin(), b.end()), cSingle(initial.begin(), initial.end());
+        vector<double> cMixed = initial;
+        sgemm(tA ? 'T' : 'N', tB ? 'T' : 'N', m, n, k, float(alpha), aSingle.data() + 2, lda, bSingle.data() + 1, ldb, float(beta), cSingle.data() + 3, ldc);
+        dsgemm(tA ? 'T' : 'N', tB ? 'T' : 'N', m, n, k, alpha, aSingle.data() + 2, lda, bSingle.data() + 1, ldb, beta, cMixed.data() + 3, ldc);
+        vector<double> cWidened(cSingle.begin(), cSingle.end());
+        double singleError = 0, mixedError = 0;
+        for (std::size_t j = 0; j < n; ++j)
+        {
+            singleError = std::max(singleError, relative_error(&reference[j * ldc + 3], &cWidened[j * ldc + 3], m));
+            mixedError = std::max(mixedError, relative_error(&reference[j * ldc + 3], &cMixed[j * ldc + 3], m));
+        }
+        if (singleError > 1e-5 || mixedError > 1e-6)
+        {
+            std::cerr << "correct test failed for sgemm/dsgemm, trans " << tA << tB << ", beta " << beta << "\n";
+            output.close();
+            return 1;
+        }
+    }
+
+    // Dense GEMV and both sparse formats against multiply_scalar with a one-column right-hand side, on a matrix with
+    // empty rows, rows of every length and a row count that is not a multiple of the SELL chunk
+    {
+        const std::size_t rows = 1001, cols = 707;
+        vector<double> dense(rows * cols, 0.0), x(cols), expectedY(rows), y(rows);
+        std::uniform_int_distribution<std::size_t> rowLength(0, 40);
+        for (std::size_t i = 0; i < rows; ++i)
+        {
+            std::size_t length = i % 10 == 0 ? 0 : rowLength(generator);
+            for (std::size_t e = 0; e < length; ++e)
+            {
+                dense[(generator() % cols) * rows + i] = distribution(generator);
+            }
+        }
+        for (double& v : x)
+        {
+            v = distribution(generator);
+        }
+        multiply_scalar(expectedY.data(), 1, rows, dense.data(), cols, rows, x.data(), 1, cols);
+
+        csr_matrix sparse = csr_from_dense(dense.data(), rows, cols);
+        sell_matrix sell = sell_from_csr(sparse, 64);
+        for (std::size_t threads : { std::size_t(1), std::size_t(3) })
+        {
+            std::fill(y.begin(), y.end(), -1.0);
+            gemv(dense.data(), rows, cols, x.data(), y.data(), threads);
+            double gemvError = relative_error(expectedY.data(), y.data(), rows);
+            std::fill(y.begin(), y.end(), -1.0);
+            spmv_csr(sparse, x.data(), y.data(), threads);
+            double csrError = relative_error(expectedY.data(), y.data(), rows);
+            std::fill(y.begin(), y.end(), -1.0);
+            spmv_sell(sell, x.data(), y.data(), threads);
+            double sellError = relative_error(expectedY.data(), y.data(), rows);
+            if (gemvError > 1e-12 || csrError > 1e-12 || sellError > 1e-12)
+            {
+                std::cerr << "correct test failed for GEMV/SpMV, T = " << threads << "\n";
+                output.close();
+                return 1;
+            }
+        }
+    }
+
+    // Transposes against the plain loop: rectangular out of place, and square in place with sizes around whole tiles
+    for (std::size_t threads : { std::size_t(1), std::size_t(3) })
+    {
+        vector<double> transposed(k * m), expectedTransposed(k * m);
+        transpose_tile_scalar(left.data(), m, expectedTransposed.data(), k, 0, m, 0, k);
+        transpose(left.data(), m, k, transposed.data(), threads);
+        if (transposed != expectedTransposed)
+        {
+            std::cerr << "correct test failed for transpose, T = " << threads << "\n";
+            output.close();
+            return 1;
+        }
+
+        for (std::size_t order : { std::size_t(1), std::size_t(7), std::size_t(64), std::size_t(130), std::size_t(203) })
+        {
+            vector<double> square(order * order), expectedSquare(order * order);
+            for (double& x : square)
+            {
+                x = distribution(generator);
+            }
+            transpose_tile_scalar(square.data(), order, expectedSquare.data(), order, 0, order, 0, order);
+            transpose_in_place(square.data(), order, threads);
+            if (square != expectedSquare)
+            {
+                std::cerr << "correct test failed for in-place transpose, order " << order << ", T = " << threads << "\n";
+                output.close();
+                return 1;
+            }
+        }
+    }
+
+    // Batched small products for every specialized order and the first generic one, on several threads
+    for (std::size_t order = 1; order <= 33; ++order)
+    {
+        const std::size_t count = 37;
+        vector<double> a(order * order * count), b(order * order * count), c(order * order * count, -1.0), reference(order * order * count);
+        for (double& x : a)
+        {
+            x = distribution(generator);
+        }
+        for (double& x : b)
+        {
+            x = distribution(generator);
+        }
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            std::size_t offset = i * order * order;
+            multiply_scalar(reference.data() + offset, order, order, a.data() + offset, order, order, b.data() + offset, order, order);
+        }
+        gemm_batched(order, count, a.data(), b.data(), c.data(), 3);
+        if (relative_error(reference.data(), c.data(), c.size()) > 1e-12)
+        {
+            std::cerr << "correct test failed for batched multiplication, order " << order << "\n";
+            output.close();
+            return 1;
+        }
+    }
+
+    if (SIMD >= simd_level::avx2)
+    {
+        multiply_packed(D.data(), matrixOrder, matrixOrder,
+            A.data(), matrixOrder, matrixOrder,
+            B.data(), matrixOrder, matrixOrder);
+        if (relative_error(C.data(), D.data(), matrixOrder * matrixOrder) > 1e-12)
+        {
+            std::cerr << "correct test failed for packed GEMM\n";
+            output.close();
+            return 1;
+        }
+
+        std::fill(actual.begin(), actual.end(), -1.0);
+        multiply_packed(actual.data(), n, m, left.data(), k, m, right.data(), n, k);
+        if (relative_error(expected.data(), actual.data(), m * n) > 1e-12)
+        {
+            std::cerr << "correct test failed for packed GEMM edge tiles\n";
+            output.close();
+            return 1;
+        }
+
+        // Thread counts that give 1-D, 2-D and uneven grids
+        for (std::size_t threads : { std::size_t(2), std::size_t(3), std::size_t(4), std::size_t(7), std::size_t(std::thread::hardware_concurrency()) })
+        {
+            std::fill(actual.begin(), actual.end(), -1.0);
+            multiply_parallel(actual.data(), n, m, left.data(), k, m, right.data(), n, k, threads);
+            if (relative_error(expected.data(), actual.data(), m * n) > 1e-12)
+            {
+                std::cerr << "correct test failed for parallel GEMM, T = " << threads << "\n";
+                output.close();
+                return 1;
+            }
+        }
+    }
+    multiply_best(D.data(), matrixOrder, matrixOrder,
         A.data(), matrixOrder, matrixOrder,
         B.data(), matrixOrder, matrixOrder);
-
-    
-    if (memcmp(C.data(), D.data(), matrixOrder * matrixOrder * sizeof(double)) != 0 ||
-        memcmp(C.data(), E.data(), matrixOrder * matrixOrder * sizeof(double)) != 0)
+    if (relative_error(C.data(), D.data(), matrixOrder * matrixOrder) > 1e-12)
     {
-        std::cerr << "correct test failed\n";
+        std::cerr << "correct test failed for the bound multiply\n";
         output.close();
         return 1;
     }
-    std::cout << "correct test passed\n";
+    std::cout << "correct test passed, detected " << simd_level_name(detected) << ", bound " << simd_level_name(SIMD) << "\n";
 
    
     output << "T,Duration,Speedup\n";
 
     double scalarTime = 0;
+    for (simd_level level : levels)
+    {
+        multiply_fn multiply = select_multiply(level);
+        double time = 0;
+        for (std::size_t i = 0; i < experimentCount; ++i)
+        {
+            randomize_matrix(A.data(), matrixOrder);
+            auto start = std::chrono::steady_clock::now();
+            multiply(D.data(), matrixOrder, matrixOrder,
+                A.data(), matrixOrder, matrixOrder,
+                B.data(), matrixOrder, matrixOrder);
+            auto end = std::chrono::steady_clock::now();
+            time += std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        }
+        time /= experimentCount;
+        if (level == simd_level::scalar)
+        {
+            scalarTime = time;
+        }
+        std::cout << simd_level_name(level) << " multiplication: " << time << " ms, Speedup = " << scalarTime / time << "\n";
+        output << simd_level_name(level) << "," << time << "," << scalarTime / time << "\n";
+    }
+
+    // The default path: multiply_best as bound at startup
+    double boundTime = 0;
     for (std::size_t i = 0; i < experimentCount; ++i)
     {
         randomize_matrix(A.data(), matrixOrder);
         auto start = std::chrono::steady_clock::now();
-        multiply_scalar(C.data(), matrixOrder, matrixOrder,
+        multiply_best(D.data(), matrixOrder, matrixOrder,
             A.data(), matrixOrder, matrixOrder,
             B.data(), matrixOrder, matrixOrder);
         auto end = std::chrono::steady_clock::now();
-        scalarTime += std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        boundTime += std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     }
-    scalarTime /= experimentCount;
-    std::cout << "Scalar multiplication: " << scalarTime << " ms, Speedup = 1.0\n";
-    output << "Scalar," << scalarTime << ",1.0\n";
+    boundTime /= experimentCount;
+    const char* boundName = SIMD >= simd_level::avx2 ? "packed" : simd_level_name(SIMD);
+    std::cout << "bound (" << boundName << ") multiplication: " << boundTime << " ms, Speedup = " << scalarTime / boundTime << "\n";
+    output << "bound " << boundName << "," << boundTime << "," << scalarTime / boundTime << "\n";
 
-    double avx2Time = 0;
-    for (std::size_t i = 0; i < experimentCount; ++i)
+    // Aligned AVX2 kernel on aligned_vector storage with each page mode; the same operands as above.
+    // dTLB misses are counted where perf events are available.
+    if (SIMD >= simd_level::avx2)
     {
-        randomize_matrix(A.data(), matrixOrder);
+        tlb_miss_counter tlbCounter;
+        for (page_mode mode : { page_mode::normal, page_mode::transparent_huge, page_mode::explicit_huge })
+        {
+            aligned_allocator<double> allocator(mode);
+            aligned_vector<double> alignedA(A.begin(), A.end(), allocator), alignedB(B.begin(), B.end(), allocator),
+                alignedD(matrixOrder * matrixOrder, 0.0, allocator);
+            // A mode that fell back (no huge page pool, or no THP on Windows) would only repeat an earlier row
+            if (buffer_page_mode(alignedA.data()) != mode || buffer_page_mode(alignedB.data()) != mode || buffer_page_mode(alignedD.data()) != mode)
+            {
+                std::cout << "aligned AVX2 multiplication, " << page_mode_name(mode) << ": unavailable, skipped\n";
+                continue;
+            }
+
+            multiply_scalar(C.data(), matrixOrder, matrixOrder,
+                A.data(), matrixOrder, matrixOrder,
+                B.data(), matrixOrder, matrixOrder);
+            multiply_avx_aligned(alignedD.data(), matrixOrder, matrixOrder,
+                alignedA.data(), matrixOrder, matrixOrder,
+                alignedB.data(), matrixOrder, matrixOrder);
+            if (relative_error(C.data(), alignedD.data(), matrixOrder * matrixOrder) > 1e-12)
+            {
+                std::cerr << "correct test failed for aligned AVX2\n";
+                output.close();
+                return 1;
+            }
+
+            double time = 0;
+            tlbCounter.start();
+            for (std::size_t i = 0; i < experimentCount; ++i)
+            {
+                auto start = std::chrono::steady_clock::now();
+                multiply_avx_aligned(alignedD.data(), matrixOrder, matrixOrder,
+                    alignedA.data(), matrixOrder, matrixOrder,
+                    alignedB.data(), matrixOrder, matrixOrder);
+                auto end = std::chrono::steady_clock::now();
+                time += std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+            }
+            long long misses = tlbCounter.stop();
+            time /= experimentCount;
+
+            const char* modeName = page_mode_name(buffer_page_mode(alignedD.data()));
+            std::cout << "aligned AVX2 multiplication, " << modeName << ": " << time << " ms, Speedup = " << scalarTime / time
+                << ", dTLB misses = " << (misses < 0 ? std::string("n/a") : std::to_string(misses / static_cast<long long>(experimentCount))) << "\n";
+            output << "aligned " << modeName << "," << time << "," << scalarTime / time << "\n";
+        }
+    }
+
+    // Parallel packed GEMM on T = 1..hardware_concurrency threads at a large order
+    if (SIMD >= simd_level::avx2)
+    {
+        const std::size_t order = 2048;
+        const std::size_t repetitions = 3;
+        vector<double> left(order * order), right(order * order), product(order * order);
+        randomize_matrix(left.data(), order);
+        randomize_matrix(right.data(), order);
+
+        double baseTime = 0;
+        for (std::size_t threads = 1; threads <= std::thread::hardware_concurrency(); ++threads)
+        {
+            double time = 0;
+            for (std::size_t i = 0; i < repetitions; ++i)
+            {
+                auto start = std::chrono::steady_clock::now();
+                multiply_parallel(product.data(), order, order,
+                    left.data(), order, order,
+                    right.data(), order, order, threads);
+                auto end = std::chrono::steady_clock::now();
+                time += std::chrono::duration<double, std::milli>(end - start).count();
+            }
+            time /= repetitions;
+            if (threads == 1)
+            {
+                baseTime = time;
+            }
+            std::cout << "parallel multiplication, order " << order << ": Threads = " << threads << ", " << time << " ms, Speedup = " << baseTime / time
+                << ", " << 2.0 * order * order * order / time * 1e-6 << " GFLOP/s\n";
+            output << threads << "," << time << "," << baseTime / time << "\n";
+        }
+    }
+
+    // Strassen-Winograd at order 2048 for each cutoff, on all threads: time and error against the parallel packed
+    // product, on entries in [-1, 1] so that the extra additions can cancel
+    if (SIMD >= simd_level::avx2)
+    {
+        const std::size_t order = 2048;
+        const std::size_t threads = std::thread::hardware_concurrency();
+        vector<double> left(order * order), right(order * order), expected(order * order), product(order * order);
+        for (double& x : left)
+        {
+            x = distribution(generator);
+        }
+        for (double& x : right)
+        {
+            x = distribution(generator);
+        }
+
         auto start = std::chrono::steady_clock::now();
-        multiply_avx(D.data(), matrixOrder, matrixOrder,
-            A.data(), matrixOrder, matrixOrder,
-            B.data(), matrixOrder, matrixOrder);
+        gemm_packed_parallel_avx2(order, order, order, left.data(), order, right.data(), order, expected.data(), order, threads);
         auto end = std::chrono::steady_clock::now();
-        avx2Time += std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        double packedTime = std::chrono::duration<double, std::milli>(end - start).count();
+        std::cout << "packed multiplication, order " << order << ": Threads = " << threads << ", " << packedTime << " ms\n";
+        output << "Cutoff,Duration,Speedup,Relative error\n";
+
+        strassen_workspace workspace;
+        for (std::size_t cutoff : { 64, 128, 256, 512, 1024 })
+        {
+            start = std::chrono::steady_clock::now();
+            strassen_multiply(order, left.data(), order, right.data(), order, product.data(), order, cutoff, threads, workspace);
+            end = std::chrono::steady_clock::now();
+            double time = std::chrono::duration<double, std::milli>(end - start).count();
+            double error = relative_error(expected.data(), product.data(), order * order);
+            if (error > 1e-10)
+            {
+                std::cerr << "correct test failed for Strassen-Winograd, cutoff " << cutoff << "\n";
+                output.close();
+                return 1;
+            }
+            std::cout << "Strassen-Winograd multiplication, cutoff " << cutoff << ": " << time << " ms, Speedup = " << packedTime / time
+                << ", relative error = " << error << "\n";
+            output << cutoff << "," << time << "," << packedTime / time << "," << error << "\n";
+        }
+    }
+
+    // Transposes of order 4096 in GB/s, a read and a write of every element, against the plain strided loop
+    {
+        const std::size_t order = 4096;
+        const std::size_t threads = std::thread::hardware_concurrency();
+        vector<double> source(order * order), destination(order * order);
+        randomize_matrix(source.data(), order);
+        transpose(source.data(), order, order, destination.data(), threads);
+        double gigabytes = 2.0 * order * order * sizeof(double) * 1e-9;
+        output << "Transpose,Duration,GB/s\n";
+
+        auto report = [&](const char* name, const std::function<void()>& call)
+            {
+                auto start = std::chrono::steady_clock::now();
+                call();
+                auto end = std::chrono::steady_clock::now();
+                double time = std::chrono::duration<double>(end - start).count();
+                std::cout << name << " transpose, order " << order << ": " << time * 1e3 << " ms, " << gigabytes / time << " GB/s\n";
+                output << name << "," << time * 1e3 << "," << gigabytes / time << "\n";
+            };
+        report("plain", [&] { transpose_tile_scalar(source.data(), order, destination.data(), order, 0, order, 0, order); });
+        report("blocked", [&] { transpose(source.data(), order, order, destination.data(), threads); });
+        report("in-place blocked", [&] { transpose_in_place(source.data(), order, threads); });
+    }
+
+    // Dense GEMV and SpMV on all threads in effective GB/s: every byte of the matrix, its index arrays, x and y
+    // counted once. The sparse matrices have 2^20 rows: a band of 9 diagonals, and 1..16 nonzeros per row at
+    // random columns.
+    {
+        const std::size_t threads = std::thread::hardware_concurrency();
+        const std::size_t repetitions = 10;
+        auto seconds_per_call = [&](const std::function<void()>& call)
+            {
+                call();
+                auto start = std::chrono::steady_clock::now();
+                for (std::size_t i = 0; i < repetitions; ++i)
+                {
+                    call();
+                }
+                auto end = std::chrono::steady_clock::now();
+                return std::chrono::duration<double>(end - start).count() / repetitions;
+            };
+        output << "Kernel,Duration,GB/s\n";
+
+        const std::size_t order = 4096;
+        vector<double> dense(order * order), x(order), y(order);
+        randomize_matrix(dense.data(), order);
+        std::fill(x.begin(), x.end(), 1.0);
+        double time = seconds_per_call([&] { gemv(dense.data(), order, order, x.data(), y.data(), threads); });
+        double gigabytes = (order * order + 2.0 * order) * sizeof(double) * 1e-9;
+        std::cout << "dense GEMV, order " << order << ": Threads = " << threads << ", " << time * 1e3 << " ms, " << gigabytes / time << " GB/s\n";
+        output << "GEMV," << time * 1e3 << "," << gigabytes / time << "\n";
+
+        const std::size_t rows = std::size_t(1) << 20;
+        vector<double> xSparse(rows, 1.0), ySparse(rows);
+        std::uniform_int_distribution<std::size_t> rowLength(1, 16), column(0, rows - 1);
+        for (int banded = 1; banded >= 0; --banded)
+        {
+            csr_matrix sparse;
+            sparse.rows = sparse.cols = rows;
+            sparse.rowStart.push_back(0);
+            for (std::size_t i = 0; i < rows; ++i)
+            {
+                vector<std::size_t> columns;
+                if (banded)
+                {
+                    for (std::size_t j = i < 4 ? 0 : i - 4; j <= std::min(rows - 1, i + 4); ++j)
+                    {
+                        columns.push_back(j);
+                    }
+                }
+                else
+                {
+                    for (std::size_t e = rowLength(generator); e > 0; --e)
+                    {
+                        columns.push_back(column(generator));
+                    }
+                    std::sort(columns.begin(), columns.end());
+                }
+                for (std::size_t j : columns)
+                {
+                    sparse.colIndex.push_back(static_cast<std::int32_t>(j));
+                    sparse.values.push_back(distribution(generator));
+                }
+                sparse.rowStart.push_back(sparse.values.size());
+            }
+            sell_matrix sell = sell_from_csr(sparse, 256);
+            const char* name = banded ? "banded" : "random";
+            double vectors = 2.0 * rows * sizeof(double);
+
+            time = seconds_per_call([&] { spmv_csr(sparse, xSparse.data(), ySparse.data(), threads); });
+            gigabytes = (sparse.values.size() * (sizeof(double) + sizeof(std::int32_t)) + sparse.rowStart.size() * sizeof(std::size_t) + vectors) * 1e-9;
+            std::cout << "CSR SpMV, " << name << ", " << sparse.values.size() << " nonzeros: " << time * 1e3 << " ms, " << gigabytes / time << " GB/s\n";
+            output << "CSR " << name << "," << time * 1e3 << "," << gigabytes / time << "\n";
+
+            time = seconds_per_call([&] { spmv_sell(sell, xSparse.data(), ySparse.data(), threads); });
+            gigabytes = (sell.values.size() * (sizeof(double) + sizeof(std::int32_t)) + (sell.chunkStart.size() + sell.chunkLength.size() + sell.permutation.size()) * sizeof(std::size_t) + vectors) * 1e-9;
+            std::cout << "SELL-4-256 SpMV, " << name << ", " << sell.values.size() << " stored entries: " << time * 1e3 << " ms, " << gigabytes / time << " GB/s\n";
+            output << "SELL-4-256 " << name << "," << time * 1e3 << "," << gigabytes / time << "\n";
+        }
+    }
+
+    // Batched small products in matrices/s, on one and on all threads, against multiply_avx called in a loop.
+    // Each batch holds 32 MiB of operands.
+    if (SIMD >= simd_level::avx2)
+    {
+        output << "Order,Batched T=1,Batched T=max,multiply_avx loop\n";
+        for (std::size_t order : { 4, 5, 8, 16, 24, 32 })
+        {
+            const std::size_t count = (std::size_t(1) << 22) / (order * order);
+            vector<double> a(order * order * count), b(order * order * count), c(order * order * count);
+            for (double& x : a)
+            {
+                x = distribution(generator);
+            }
+            for (double& x : b)
+            {
+                x = distribution(generator);
+            }
+
+            auto rate = [&](const std::function<void()>& multiplyAll)
+                {
+                    multiplyAll();
+                    auto start = std::chrono::steady_clock::now();
+                    multiplyAll();
+                    auto end = std::chrono::steady_clock::now();
+                    return count / std::chrono::duration<double>(end - start).count();
+                };
+            double single = rate([&] { gemm_batched(order, count, a.data(), b.data(), c.data(), 1); });
+            double all = rate([&] { gemm_batched(order, count, a.data(), b.data(), c.data(), std::thread::hardware_concurrency()); });
+            double loop = rate([&]
+                {
+                    for (std::size_t i = 0; i < count; ++i)
+                    {
+                        std::size_t offset = i * order * order;
+                        multiply_avx(c.data() + offset, order, order, a.data() + offset, order, order, b.data() + offset, order, order);
+                    }
+                });
+            std::cout << "batched multiplication, order " << order << ": " << single << " matrices/s on 1 thread, " << all << " on "
+                << std::thread::hardware_concurrency() << ", multiply_avx loop " << loop << " (Speedup = " << single / loop << ", " << all / loop << ")\n";
+            output << order << "," << single << "," << all << "," << loop << "\n";
+        }
+    }
+
+    // Double, single and mixed precision at order 1024: throughput gain over dgemm next to the error against the
+    // double multiply_scalar reference, on entries in [-1, 1]
+    if (SIMD >= simd_level::avx2)
+    {
+        const std::size_t order = 1024;
+        const std::size_t repetitions = 3;
+        vector<double> left(order * order), right(order * order), expected(order * order), product(order * order);
+        for (double& x : left)
+        {
+            x = distribution(generator);
+        }
+        for (double& x : right)
+        {
+            x = distribution(generator);
+        }
+        vector<float> leftSingle(left.begin(), left.end()), rightSingle(right.begin(), right.end()), productSingle(order * order);
+        multiply_scalar(expected.data(), order, order, left.data(), order, order, right.data(), order, order);
+
+        auto time_gemm = [&](const std::function<void()>& gemm)
+            {
+                auto start = std::chrono::steady_clock::now();
+                for (std::size_t i = 0; i < repetitions; ++i)
+                {
+                    gemm();
+                }
+                auto end = std::chrono::steady_clock::now();
+                return std::chrono::duration<double, std::milli>(end - start).count() / repetitions;
+            };
+
+        output << "Precision,Duration,Speedup,Relative error\n";
+        double doubleTime = 0;
+        auto report = [&](const char* name, double time, const double* result)
+            {
+                if (doubleTime == 0)
+                {
+                    doubleTime = time;
+                }
+                double error = relative_error(expected.data(), result, order * order);
+                std::cout << name << " multiplication, order " << order << ": " << time << " ms, " << 2.0 * order * order * order / time * 1e-6
+                    << " GFLOP/s, Speedup = " << doubleTime / time << ", relative error = " << error << "\n";
+                output << name << "," << time << "," << doubleTime / time << "," << error << "\n";
+            };
+
+        report("dgemm AVX2", time_gemm([&] { dgemm_packed_avx2(false, false, order, order, order, 1.0, left.data(), order, right.data(), order, 0.0, product.data(), order); }),
+            product.data());
+        report("dsgemm AVX2", time_gemm([&] { dsgemm_packed_avx2(false, false, order, order, order, 1.0, leftSingle.data(), order, rightSingle.data(), order, 0.0, product.data(), order); }),
+            product.data());
+        double singleTime = time_gemm([&] { sgemm_packed_avx2(false, false, order, order, order, 1.0f, leftSingle.data(), order, rightSingle.data(), order, 0.0f, productSingle.data(), order); });
+        std::copy(productSingle.begin(), productSingle.end(), product.begin());
+        report("sgemm AVX2", singleTime, product.data());
+        if (detected >= simd_level::avx512)
+        {
+            singleTime = time_gemm([&] { sgemm_packed_avx512(false, false, order, order, order, 1.0f, leftSingle.data(), order, rightSingle.data(), order, 0.0f, productSingle.data(), order); });
+            std::copy(productSingle.begin(), productSingle.end(), product.begin());
+            report("sgemm AVX-512", singleTime, product.data());
+        }
+    }
+
+    // Packed GEMM across orders in GFLOP/s, against the measured single-core peak. The unpacked kernel
+    // of the bound level is timed alongside up to order 1024.
+    if (SIMD >= simd_level::avx2)
+    {
+        double peak = measure_peak_gflops_avx2();
+        std::cout << "peak: " << peak << " GFLOP/s per core\n";
+        output << "Order,Duration,GFLOPS,Peak fraction\n";
+
+        for (std::size_t order = 64; order <= 4096; order *= 2)
+        {
+            vector<double> left(order * order), right(order * order), product(order * order);
+            randomize_matrix(left.data(), order);
+            randomize_matrix(right.data(), order);
+            double flops = 2.0 * order * order * order;
+            std::size_t repetitions = std::max<std::size_t>(1, (std::size_t(1) << 29) / (order * order * order));
+
+            auto time_multiply = [&](multiply_fn multiply)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    for (std::size_t i = 0; i < repetitions; ++i)
+                    {
+                        multiply(product.data(), order, order,
+                            left.data(), order, order,
+                            right.data(), order, order);
+                    }
+                    auto end = std::chrono::steady_clock::now();
+                    return std::chrono::duration<double, std::milli>(end - start).count() / repetitions;
+                };
+
+            double time = time_multiply(multiply_packed);
+            double gflops = flops / time * 1e-6;
+            std::cout << "packed multiplication, order " << order << ": " << time << " ms, " << gflops << " GFLOP/s, "
+                << 100.0 * gflops / peak << "% of peak";
+            output << order << "," << time << "," << gflops << "," << gflops / peak << "\n";
+            if (order <= 1024)
+            {
+                double unpackedTime = time_multiply(select_multiply(SIMD));
+                std::cout << ", " << simd_level_name(SIMD) << " unpacked " << flops / unpackedTime * 1e-6 << " GFLOP/s";
+            }
+            std::cout << "\n";
+        }
     }
-    avx2Time /= experimentCount;
-    std::cout << "AVX2 multiplication: " << avx2Time << " ms, Speedup = " << scalarTime / avx2Time << "\n";
-    output << "AVX2," << avx2Time << "," << scalarTime / avx2Time << "\n";
 
     output.close();
     return 0;
@@ -5,6 +5,12 @@
 #include <fstream>
 #include <iomanip>
 #include "num_threads.h"
+#include "file_mod.h"
+#include "incremental_mod.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
 
 int main(int argc, char** argv)
 {
@@ -16,6 +22,110 @@ int main(int argc, char** argv)
 			std::cout << "FAILURE==\n";
 			return -1;
 		}
+		for (std::size_t iModulus = 0; iModulus < extra_test_moduli_count; ++iModulus)
+		{
+			IntegerWord modulus = extra_test_moduli[iModulus];
+			//The full dividend and one word shorter, so that lane kernels also see a partial last row
+			for (std::size_t size = test_data[iTest].dividend_size - 1; size <= test_data[iTest].dividend_size; ++size)
+			{
+				if (vector_mod_reference(test_data[iTest].dividend, size, modulus) != vector_mod(test_data[iTest].dividend, size, modulus))
+				{
+					std::cout << "FAILURE==\n";
+					return -1;
+				}
+			}
+		}
+		for (std::size_t iModulus = 0; iModulus < extra_test_moduli_count; ++iModulus)
+		{
+			//Chunks of 100 words, so that every dividend above 100 words is split and combined by offset
+			IntegerWord modulus = extra_test_moduli[iModulus];
+			if (vector_mod_dynamic(test_data[iTest].dividend, test_data[iTest].dividend_size, modulus, 100) !=
+				vector_mod(test_data[iTest].dividend, test_data[iTest].dividend_size, modulus))
+			{
+				std::cout << "FAILURE==\n";
+				return -1;
+			}
+		}
+		IntegerWord batch_results[extra_test_moduli_count];
+		vector_mod_batch(test_data[iTest].dividend, test_data[iTest].dividend_size, extra_test_moduli, extra_test_moduli_count, batch_results);
+		for (std::size_t iModulus = 0; iModulus < extra_test_moduli_count; ++iModulus)
+		{
+			if (batch_results[iModulus] != vector_mod(test_data[iTest].dividend, test_data[iTest].dividend_size, extra_test_moduli[iModulus]))
+			{
+				std::cout << "FAILURE==\n";
+				return -1;
+			}
+		}
+	}
+	{
+		//The largest dividend plus three bytes of a partial word, through each file front end with small and default chunks
+		const test_datum& datum = test_data[test_data_count - 1];
+		const char* path = "vector_mod_test.bin";
+		std::vector<IntegerWord> words(datum.dividend, datum.dividend + datum.dividend_size);
+		words.push_back(0);
+		std::memcpy(&words.back(), datum.dividend, 3);
+		std::FILE* file = std::fopen(path, "wb");
+		bool written = file && std::fwrite(words.data(), 1, datum.dividend_size * sizeof(IntegerWord) + 3, file) == datum.dividend_size * sizeof(IntegerWord) + 3;
+		if (file)
+			std::fclose(file);
+		IntegerWord expected = vector_mod_reference(words.data(), words.size(), datum.divisor), result = 0;
+		bool ok = written;
+		for (std::size_t chunk_bytes : {std::size_t(1000), FILE_CHUNK_BYTES})
+		{
+			ok = ok && vector_mod_file_read(path, datum.divisor, &result, chunk_bytes) && result == expected;
+#if FILE_MOD_POSIX
+			ok = ok && vector_mod_file_mmap(path, datum.divisor, &result, chunk_bytes) && result == expected;
+#endif
+		}
+		std::remove(path);
+		if (!ok)
+		{
+			std::cout << "FAILURE==\n";
+			return -1;
+		}
+	}
+	{
+		//A mixed sequence of edits on the largest dividend; after each one both objects must match a full recompute
+		const test_datum& datum = test_data[test_data_count - 1];
+		std::size_t half = datum.dividend_size / 2;
+		for (IntegerWord modulus : {datum.divisor, extra_test_moduli[1]})
+		{
+			std::vector<IntegerWord> words(datum.dividend, datum.dividend + half);
+			residue_tracker tracker(words.data(), words.size(), modulus);
+			residue_tree tree(words.data(), words.size(), modulus);
+			bool ok = true;
+			auto check = [&]()
+			{
+				IntegerWord expected = vector_mod_reference(words.data(), words.size(), modulus);
+				ok = ok && tracker.value() == expected && tree.value() == expected && tree.size() == words.size();
+			};
+			check();
+			tracker.append(datum.dividend + half, half);
+			tree.append(datum.dividend + half, half);
+			words.insert(words.end(), datum.dividend + half, datum.dividend + 2 * half);
+			check();
+			tracker.overwrite(10, words.data() + 10, datum.dividend + 700, 290);
+			tree.overwrite(10, datum.dividend + 700, 290);
+			std::copy(datum.dividend + 700, datum.dividend + 990, words.begin() + 10);
+			check();
+			tracker.overwrite(513, words.data() + 513, datum.dividend + 1, 1);
+			tree.set(513, datum.dividend[1]);
+			words[513] = datum.dividend[1];
+			check();
+			tracker.truncate(333, words.data() + 333);
+			tree.truncate(333);
+			words.resize(333);
+			check();
+			tracker.append(datum.dividend, datum.dividend_size);
+			tree.append(datum.dividend, datum.dividend_size);
+			words.insert(words.end(), datum.dividend, datum.dividend + datum.dividend_size);
+			check();
+			if (!ok)
+			{
+				std::cout << "FAILURE==\n";
+				return -1;
+			}
+		}
 	}
 	std::cout << "ok.==\n";
 
@@ -26,19 +136,103 @@ int main(int argc, char** argv)
 		return 1;
 	}
 
-	file << "T,Duration,Speedup\n";
+	file << "T,Duration,Speedup,DynamicDuration,DynamicSpeedup\n";
 
 	std::cout << "==Performance tests. ";
 	auto measurements = run_experiments();
 	std::cout << "Done==\n";
 	std::cout << std::setfill(' ') << std::setw(2) << "T:" << " |" << std::setw(3 + 2 * sizeof(IntegerWord)) << "Value:" << " | " <<
-		std::setw(14) << "Duration, ms:" << " | Acceleration:\n";
+		std::setw(14) << "Duration, ms:" << " | " << std::setw(13) << "Acceleration:" << " | " << std::setw(13) << "Dynamic, ms:" << " | Dynamic acceleration:\n";
 	for (std::size_t T = 1; T <= measurements.size(); ++T)
 	{
+		if (measurements[T - 1].dynamic_result != measurements[T - 1].result)
+		{
+			std::cout << "Dynamic result mismatch for T = " << T << "\n";
+			return -1;
+		}
+		double speedup = static_cast<double>(measurements[0].time.count()) / measurements[T - 1].time.count();
+		double dynamic_speedup = static_cast<double>(measurements[0].time.count()) / measurements[T - 1].dynamic_time.count();
 		std::cout << std::setw(2) << T << " | 0x" << std::setw(2 * sizeof(IntegerWord)) << std::setfill('0') << std::hex << measurements[T - 1].result;
 		std::cout << " | " << std::setfill(' ') << std::setw(14) << std::dec << measurements[T - 1].time.count();
-		std::cout << " | " << (static_cast<double>(measurements[0].time.count()) / measurements[T - 1].time.count()) << "\n";
-		file << T << "," << measurements[T - 1].time.count() << "," << (static_cast<double>(measurements[0].time.count()) / measurements[T - 1].time.count()) <<  "\n";
+		std::cout << " | " << std::setw(13) << speedup << " | " << std::setw(13) << measurements[T - 1].dynamic_time.count() << " | " << dynamic_speedup << "\n";
+		file << T << "," << measurements[T - 1].time.count() << "," << speedup << "," << measurements[T - 1].dynamic_time.count() << "," << dynamic_speedup << "\n";
+	}
+
+	std::cout << "==Kernel tests. ";
+	auto kernel_measurements = run_kernel_experiments();
+	std::cout << "Done==\n";
+	std::cout << std::setw(15) << "Kernel:" << " |" << std::setw(3 + 2 * sizeof(IntegerWord)) << "Modulus:" << " |" <<
+		std::setw(3 + 2 * sizeof(IntegerWord)) << "Value:" << " | " << std::setw(14) << "Duration, ms:" << " | Gain over scalar:\n";
+	file << "Kernel,Modulus,Duration,Speedup\n";
+	for (auto& measurement : kernel_measurements)
+	{
+		double gain = static_cast<double>(kernel_measurements[0].time.count()) / measurement.time.count();
+		std::cout << std::setw(15) << measurement.kernel << " | 0x" << std::setw(2 * sizeof(IntegerWord)) << std::setfill('0') << std::hex << measurement.modulus;
+		std::cout << " | 0x" << std::setw(2 * sizeof(IntegerWord)) << measurement.result;
+		std::cout << " | " << std::setfill(' ') << std::setw(14) << std::dec << measurement.time.count() << " | " << gain << "\n";
+		file << measurement.kernel << "," << measurement.modulus << "," << measurement.time.count() << "," << gain << "\n";
+	}
+
+	std::cout << "==Batch tests. ";
+	auto batch_measurements = run_batch_experiments();
+	std::cout << "Done==\n";
+	std::cout << std::setw(7) << "Moduli:" << " | " << std::setw(14) << "Duration, ms:" << " | " << std::setw(13) << "Per modulus:" <<
+		" | Gain over separate calls:\n";
+	file << "Moduli,Duration,PerModulus\n";
+	for (auto& batch : batch_measurements)
+	{
+		double per_modulus = static_cast<double>(batch.time.count()) / batch.moduli;
+		std::cout << std::setw(7) << batch.moduli << " | " << std::setw(14) << batch.time.count() << " | " << std::setw(13) << per_modulus <<
+			" | " << (batch_measurements[0].time.count() / per_modulus) << "\n";
+		file << batch.moduli << "," << batch.time.count() << "," << per_modulus << "\n";
+	}
+
+	std::cout << "==File tests. ";
+	auto file_measurements = run_file_experiments("vector_mod_input.bin");
+	std::cout << "Done==\n";
+	std::cout << std::setw(7) << "Method:" << " |" << std::setw(3 + 2 * sizeof(IntegerWord)) << "Value:" << " | " <<
+		std::setw(14) << "Duration, ms:" << " | GB/s:\n";
+	file << "Method,Duration,Throughput\n";
+	for (auto& measurement : file_measurements)
+	{
+		double throughput = FILE_BENCHMARK_BYTES / 1e6 / measurement.time.count();
+		std::cout << std::setw(7) << measurement.method << " | 0x" << std::setw(2 * sizeof(IntegerWord)) << std::setfill('0') << std::hex << measurement.result;
+		std::cout << " | " << std::setfill(' ') << std::setw(14) << std::dec << measurement.time.count() << " | " << throughput << "\n";
+		file << measurement.method << "," << measurement.time.count() << "," << throughput << "\n";
+	}
+
+	std::cout << "==Incremental tests. ";
+	auto update_measurements = run_incremental_experiments();
+	std::cout << "Done==\n";
+	std::cout << std::setw(22) << "Operation:" << " | " << std::setw(14) << "Latency, us:" << " | Gain over full recompute:\n";
+	file << "Operation,Microseconds\n";
+	for (auto& measurement : update_measurements)
+	{
+		if (!measurement.matches)
+		{
+			std::cout << "Residue mismatch after " << measurement.operation << "\n";
+			return -1;
+		}
+		std::cout << std::setw(22) << measurement.operation << " | " << std::setw(14) << measurement.microseconds << " | " <<
+			update_measurements[0].microseconds / measurement.microseconds << "\n";
+		file << measurement.operation << "," << measurement.microseconds << "\n";
+	}
+
+	std::cout << "==Thread pool tests. ";
+	auto overhead_measurements = run_overhead_experiments();
+	std::cout << "Done==\n";
+	std::cout << std::setw(12) << "Bytes:" << " | " << std::setw(12) << "Pool, us:" << " | " << std::setw(14) << "Spawning, us:" << " | Gain:\n";
+	file << "Bytes,PoolMicroseconds,SpawningMicroseconds\n";
+	for (auto& measurement : overhead_measurements)
+	{
+		if (measurement.pooled_result != measurement.spawning_result)
+		{
+			std::cout << "Pool and spawning result mismatch for " << measurement.bytes << " bytes\n";
+			return -1;
+		}
+		std::cout << std::setw(12) << measurement.bytes << " | " << std::setw(12) << measurement.pooled_microseconds << " | " <<
+			std::setw(14) << measurement.spawning_microseconds << " | " << measurement.spawning_microseconds / measurement.pooled_microseconds << "\n";
+		file << measurement.bytes << "," << measurement.pooled_microseconds << "," << measurement.spawning_microseconds << "\n";
 	}
 	file.close();
 
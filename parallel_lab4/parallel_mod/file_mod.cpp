@@ -0,0 +1,113 @@
+#include "file_mod.h"
+#include "mod_ops.h"
+#include "vector_mod.h"
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <vector>
+
+#if FILE_MOD_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//sum + residue * power and the power for the chunk after it
+static void fold_chunk(IntegerWord& sum, IntegerWord& offset_power, IntegerWord residue, IntegerWord chunk_power, IntegerWord mod)
+{
+	sum = add_mod(sum, mul_mod(residue, offset_power, mod), mod);
+	offset_power = mul_mod(offset_power, chunk_power, mod);
+}
+
+bool vector_mod_file_read(const char* path, IntegerWord mod, IntegerWord* result, std::size_t chunk_bytes)
+{
+	std::FILE* file = std::fopen(path, "rb");
+	if (!file)
+		return false;
+#if FILE_MOD_POSIX
+	posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	std::size_t chunk_words = chunk_bytes / sizeof(IntegerWord) ? chunk_bytes / sizeof(IntegerWord) : 1;
+	std::vector<IntegerWord> buffers[2] = {std::vector<IntegerWord>(chunk_words), std::vector<IntegerWord>(chunk_words)};
+	auto read_chunk = [file, chunk_words](IntegerWord* buffer)
+	{
+		return std::fread(buffer, 1, chunk_words * sizeof(IntegerWord), file);
+	};
+
+	IntegerWord sum = 0, offset_power = 1 % mod, chunk_power = word_pow_mod(chunk_words, mod);
+	std::size_t bytes = read_chunk(buffers[0].data());
+	for (unsigned current = 0; bytes > 0; current ^= 1)
+	{
+		auto next = std::async(std::launch::async, read_chunk, buffers[current ^ 1].data());
+		std::size_t words = ceil_div(bytes, sizeof(IntegerWord));
+		std::memset((unsigned char*) buffers[current].data() + bytes, 0, words * sizeof(IntegerWord) - bytes);
+		fold_chunk(sum, offset_power, vector_mod(buffers[current].data(), words, mod), chunk_power, mod);
+		bytes = next.get();
+	}
+	bool ok = !std::ferror(file);
+	std::fclose(file);
+	if (ok)
+		*result = sum;
+	return ok;
+}
+
+#if FILE_MOD_POSIX
+bool vector_mod_file_mmap(const char* path, IntegerWord mod, IntegerWord* result, std::size_t chunk_bytes)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		close(fd);
+		return false;
+	}
+	std::size_t size = (std::size_t) info.st_size;
+	if (size == 0)
+	{
+		close(fd);
+		*result = 0;
+		return true;
+	}
+	void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+		return false;
+	const unsigned char* bytes = (const unsigned char*) mapping;
+	madvise(mapping, size, MADV_SEQUENTIAL);
+
+	std::size_t page = (std::size_t) sysconf(_SC_PAGESIZE);
+	std::size_t chunk = chunk_bytes >= page ? chunk_bytes / page * page : page;
+	std::size_t words = size / sizeof(IntegerWord);
+	IntegerWord sum = 0, offset_power = 1 % mod, chunk_power = word_pow_mod(chunk / sizeof(IntegerWord), mod);
+	for (std::size_t begin = 0; begin < size; begin += chunk)
+	{
+		std::size_t end = begin + chunk < size ? begin + chunk : size;
+		if (end < size)
+			madvise((void*) (bytes + end), size - end < chunk ? size - end : chunk, MADV_WILLNEED);
+		std::size_t chunk_words = (end - begin) / sizeof(IntegerWord);
+		fold_chunk(sum, offset_power, vector_mod((const IntegerWord*) (bytes + begin), chunk_words, mod), chunk_power, mod);
+		madvise((void*) (bytes + begin), end - begin, MADV_DONTNEED);
+	}
+	if (size % sizeof(IntegerWord))
+	{
+		IntegerWord last = 0;
+		std::memcpy(&last, bytes + words * sizeof(IntegerWord), size % sizeof(IntegerWord));
+		sum = add_mod(sum, mul_mod(last % mod, word_pow_mod(words, mod), mod), mod);
+	}
+	munmap(mapping, size);
+	*result = sum;
+	return true;
+}
+#endif //FILE_MOD_POSIX
+
+bool vector_mod_file(const char* path, IntegerWord mod, IntegerWord* result, std::size_t chunk_bytes)
+{
+#if FILE_MOD_POSIX
+	return vector_mod_file_mmap(path, mod, result, chunk_bytes);
+#else
+	return vector_mod_file_read(path, mod, result, chunk_bytes);
+#endif
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "config.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FILE_MOD_POSIX 1
+#else
+#define FILE_MOD_POSIX 0
+#endif
+
+//Bytes reduced per vector_mod call; memory stays within about two chunks whatever the file size
+constexpr std::size_t FILE_CHUNK_BYTES = std::size_t(64) << 20;
+
+//V mod m for V stored in a file as native words, lowest first, a trailing partial word read as zero-extended.
+//The file is reduced chunk by chunk, I/O on the next chunk overlapping vector_mod on the current one, and each
+//chunk's residue is shifted by w^(its first word). Returns false when the file cannot be opened or read.
+bool vector_mod_file(const char* path, IntegerWord mod, IntegerWord* result, std::size_t chunk_bytes = FILE_CHUNK_BYTES);
+
+//Portable variant: two buffers, the next chunk read by another thread
+bool vector_mod_file_read(const char* path, IntegerWord mod, IntegerWord* result, std::size_t chunk_bytes = FILE_CHUNK_BYTES);
+
+#if FILE_MOD_POSIX
+//Whole-file read-only mapping walked with madvise: WILLNEED starts readahead of the next chunk, DONTNEED drops
+//the pages of the finished one. chunk_bytes is rounded down to whole pages.
+bool vector_mod_file_mmap(const char* path, IntegerWord mod, IntegerWord* result, std::size_t chunk_bytes = FILE_CHUNK_BYTES);
+#endif //FILE_MOD_POSIX
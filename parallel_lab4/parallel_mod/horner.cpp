@@ -0,0 +1,258 @@
+#include "horner.h"
+
+#if INTWORD_MAX == 0xffffffffffffffffu && (defined(__x86_64__) || defined(_M_X64))
+#define HORNER_SIMD 1
+#include "../../common/cpu_dispatch.h"
+#include <immintrin.h>
+
+static const simd_level SIMD = selected_simd_level();
+static const bool IFMA = SIMD == simd_level::avx512 && detect_avx512_ifma();
+#else
+#define HORNER_SIMD 0
+#endif
+
+//Ranges shorter than this are not worth computing the lane constants for
+static const std::size_t LANES_MIN_WORDS = 256;
+static const std::size_t SCALAR_LANES = 6;
+static const std::size_t AVX2_LANES = 16;
+static const std::size_t IFMA_LANES = 32;
+
+IntegerWord horner_mod(const mod_context& ctx, const IntegerWord* V, std::size_t start, std::size_t end)
+{
+	IntegerWord sum = 0;
+	if (ctx.montgomery)
+	{
+		for (std::size_t i = end; i > start;)
+			sum = montgomery_horner_step(ctx, sum, V[--i]);
+		return montgomery_horner_step(ctx, sum, 0);
+	}
+	for (std::size_t i = end; i > start;)
+		sum = barrett_horner_step(ctx, sum, V[--i]);
+	return sum;
+}
+
+//Lane l of K chains accumulates S_l = sum of V[l + j * K] * w^(j * K) over j, the words of a partial last row
+//included; the range is then sum of S_l * w^l, one more Horner pass over the K lane values. Every chain starts
+//from its partial-row word (zero when there is none) and steps down the full rows.
+
+//K scalar chains with multiplier w^K: Montgomery states are S_l * w^-1, which makes the multiplier w^(K + 1)
+template <bool Montgomery, std::size_t K>
+static void horner_update_scalar(horner_state& state, const IntegerWord* V, std::size_t n)
+{
+	const mod_context& ctx = state.ctx;
+	std::size_t rows = n / K, tail = n % K;
+	IntegerWord step = state.step;
+	IntegerWord acc[K];
+	for (std::size_t l = 0; l < K; ++l)
+		acc[l] = state.acc[l];
+	if (tail)
+	{
+		for (std::size_t l = 0; l < K; ++l)
+		{
+			IntegerWord word = l < tail ? V[rows * K + l] : 0;
+			acc[l] = Montgomery ? montgomery_mul_add(ctx, acc[l], step, word) : barrett_mul_add(ctx, acc[l], step, word);
+		}
+	}
+	for (std::size_t j = rows; j > 0;)
+	{
+		const IntegerWord* row = V + --j * K;
+		for (std::size_t l = 0; l < K; ++l)
+			acc[l] = Montgomery ? montgomery_mul_add(ctx, acc[l], step, row[l]) : barrett_mul_add(ctx, acc[l], step, row[l]);
+	}
+	for (std::size_t l = 0; l < K; ++l)
+		state.acc[l] = acc[l];
+}
+
+#if HORNER_SIMD
+//Montgomery reduction with R = 2^32 in each 64-bit lane: t * 2^-32 mod m for t < 2^62 + 2^32, m < 2^31.
+//The sum t + q * m fits 64 bits and its high half is below 2m; min_epu32 then subtracts m where needed.
+TARGET_AVX2 static inline __m256i montgomery32_reduce_avx2(__m256i t, __m256i mod, __m256i inverse)
+{
+	__m256i q = _mm256_mul_epu32(t, inverse);
+	__m256i r = _mm256_srli_epi64(_mm256_add_epi64(t, _mm256_mul_epu32(q, mod)), 32);
+	return _mm256_min_epu32(r, _mm256_sub_epi64(r, mod));
+}
+
+//One word per lane as two 32-bit digits: the high digit with multiplier w^K (w^K * 2^-32 * R), the low one with
+//w mod m (2^32 * R)
+TARGET_AVX2 static inline __m256i montgomery32_step_avx2(__m256i x, __m256i word, __m256i high_step, __m256i low_step,
+	__m256i mod, __m256i inverse)
+{
+	x = montgomery32_reduce_avx2(_mm256_add_epi64(_mm256_mul_epu32(x, high_step), _mm256_srli_epi64(word, 32)), mod, inverse);
+	__m256i low = _mm256_and_si256(word, _mm256_set1_epi64x(0xffffffff));
+	return montgomery32_reduce_avx2(_mm256_add_epi64(_mm256_mul_epu32(x, low_step), low), mod, inverse);
+}
+
+//Odd m < 2^31: 16 chains in four vectors
+TARGET_AVX2 static void horner_update_avx2(horner_state& state, const IntegerWord* V, std::size_t n)
+{
+	constexpr std::size_t K = AVX2_LANES;
+	std::size_t rows = n / K, tail = n % K;
+	__m256i mod = _mm256_set1_epi64x((long long) state.ctx.mod);
+	__m256i inverse = _mm256_set1_epi64x((long long) (-state.ctx.inverse & 0xffffffff));
+	__m256i high_step = _mm256_set1_epi64x((long long) state.step);
+	__m256i low_step = _mm256_set1_epi64x((long long) state.ctx.word);
+
+	__m256i* acc = reinterpret_cast<__m256i*>(state.acc);
+	__m256i x0 = _mm256_load_si256(acc), x1 = _mm256_load_si256(acc + 1);
+	__m256i x2 = _mm256_load_si256(acc + 2), x3 = _mm256_load_si256(acc + 3);
+	if (tail)
+	{
+		alignas(32) IntegerWord partial[K] = {};
+		for (std::size_t l = 0; l < tail; ++l)
+			partial[l] = V[rows * K + l];
+		const __m256i* row = reinterpret_cast<const __m256i*>(partial);
+		x0 = montgomery32_step_avx2(x0, _mm256_load_si256(row), high_step, low_step, mod, inverse);
+		x1 = montgomery32_step_avx2(x1, _mm256_load_si256(row + 1), high_step, low_step, mod, inverse);
+		x2 = montgomery32_step_avx2(x2, _mm256_load_si256(row + 2), high_step, low_step, mod, inverse);
+		x3 = montgomery32_step_avx2(x3, _mm256_load_si256(row + 3), high_step, low_step, mod, inverse);
+	}
+	for (std::size_t j = rows; j > 0;)
+	{
+		const __m256i* row = reinterpret_cast<const __m256i*>(V + --j * K);
+		x0 = montgomery32_step_avx2(x0, _mm256_loadu_si256(row), high_step, low_step, mod, inverse);
+		x1 = montgomery32_step_avx2(x1, _mm256_loadu_si256(row + 1), high_step, low_step, mod, inverse);
+		x2 = montgomery32_step_avx2(x2, _mm256_loadu_si256(row + 2), high_step, low_step, mod, inverse);
+		x3 = montgomery32_step_avx2(x3, _mm256_loadu_si256(row + 3), high_step, low_step, mod, inverse);
+	}
+	_mm256_store_si256(acc, x0);
+	_mm256_store_si256(acc + 1, x1);
+	_mm256_store_si256(acc + 2, x2);
+	_mm256_store_si256(acc + 3, x3);
+}
+
+//Montgomery step with R = 2^52 on IFMA: x * c + word as a 52-bit low part (below 2^53) and a high part below
+//m + 2^12, reduced to below 2m + 2^12 + 2 < 3m (m >= 2^13) and brought under m by two masked subtractions.
+//Shifts use the full-mask srli form: GCC's plain srli_epi64 and min_epu64 pass an undefined source that -Wall reports
+TARGET_AVX512IFMA static inline __m512i montgomery52_step_avx512(__m512i x, __m512i word, __m512i step,
+	__m512i mod, __m512i inverse)
+{
+	__m512i low = _mm512_madd52lo_epu64(_mm512_and_si512(word, _mm512_set1_epi64(0xfffffffffffff)), x, step);
+	__m512i high = _mm512_madd52hi_epu64(_mm512_mask_srli_epi64(word, 0xFF, word, 52), x, step);
+	__m512i q = _mm512_madd52lo_epu64(_mm512_setzero_si512(), low, inverse);
+	__m512i product = _mm512_madd52lo_epu64(low, q, mod);
+	__m512i carry = _mm512_mask_srli_epi64(product, 0xFF, product, 52);
+	__m512i r = _mm512_madd52hi_epu64(_mm512_add_epi64(high, carry), q, mod);
+	r = _mm512_mask_sub_epi64(r, _mm512_cmpge_epu64_mask(r, mod), r, mod);
+	return _mm512_mask_sub_epi64(r, _mm512_cmpge_epu64_mask(r, mod), r, mod);
+}
+
+//Odd m in [2^13, 2^52): 32 chains in four vectors, multiplier w^K * 2^52 mod m
+TARGET_AVX512IFMA static void horner_update_ifma(horner_state& state, const IntegerWord* V, std::size_t n)
+{
+	constexpr std::size_t K = IFMA_LANES;
+	std::size_t rows = n / K, tail = n % K;
+	__m512i mod = _mm512_set1_epi64((long long) state.ctx.mod);
+	__m512i inverse = _mm512_set1_epi64((long long) (-state.ctx.inverse & 0xfffffffffffff));
+	__m512i step = _mm512_set1_epi64((long long) state.step);
+
+	IntegerWord* acc = state.acc;
+	__m512i x0 = _mm512_load_si512(acc), x1 = _mm512_load_si512(acc + 8);
+	__m512i x2 = _mm512_load_si512(acc + 16), x3 = _mm512_load_si512(acc + 24);
+	if (tail)
+	{
+		alignas(64) IntegerWord partial[K] = {};
+		for (std::size_t l = 0; l < tail; ++l)
+			partial[l] = V[rows * K + l];
+		x0 = montgomery52_step_avx512(x0, _mm512_load_si512(partial), step, mod, inverse);
+		x1 = montgomery52_step_avx512(x1, _mm512_load_si512(partial + 8), step, mod, inverse);
+		x2 = montgomery52_step_avx512(x2, _mm512_load_si512(partial + 16), step, mod, inverse);
+		x3 = montgomery52_step_avx512(x3, _mm512_load_si512(partial + 24), step, mod, inverse);
+	}
+	for (std::size_t j = rows; j > 0;)
+	{
+		const IntegerWord* row = V + --j * K;
+		x0 = montgomery52_step_avx512(x0, _mm512_loadu_si512(row), step, mod, inverse);
+		x1 = montgomery52_step_avx512(x1, _mm512_loadu_si512(row + 8), step, mod, inverse);
+		x2 = montgomery52_step_avx512(x2, _mm512_loadu_si512(row + 16), step, mod, inverse);
+		x3 = montgomery52_step_avx512(x3, _mm512_loadu_si512(row + 24), step, mod, inverse);
+	}
+	_mm512_store_si512(acc, x0);
+	_mm512_store_si512(acc + 8, x1);
+	_mm512_store_si512(acc + 16, x2);
+	_mm512_store_si512(acc + 24, x3);
+}
+#endif //HORNER_SIMD
+
+void horner_start(horner_state& state, const mod_context& ctx, std::size_t words)
+{
+	state.ctx = ctx;
+	for (IntegerWord& acc : state.acc)
+		acc = 0;
+	IntegerWord mod = ctx.mod;
+#if HORNER_SIMD
+	if (words >= LANES_MIN_WORDS && IFMA && ctx.montgomery && mod >> 13 && !(mod >> 52))
+	{
+		state.kernel = horner_kernel::ifma;
+		state.lanes = IFMA_LANES;
+		state.step = mul_mod(word_pow_mod(IFMA_LANES, mod), ((IntegerWord) 1 << 52) % mod, mod);
+		return;
+	}
+	if (words >= LANES_MIN_WORDS && SIMD >= simd_level::avx2 && ctx.montgomery && !(mod >> 31))
+	{
+		state.kernel = horner_kernel::avx2;
+		state.lanes = AVX2_LANES;
+		state.step = word_pow_mod(AVX2_LANES, mod);
+		return;
+	}
+#endif
+	state.kernel = words >= LANES_MIN_WORDS ? horner_kernel::scalar : horner_kernel::scalar_single;
+	state.lanes = words >= LANES_MIN_WORDS ? SCALAR_LANES : 1;
+	state.step = word_pow_mod(ctx.montgomery ? state.lanes + 1 : state.lanes, mod);
+}
+
+void horner_update(horner_state& state, const IntegerWord* V, std::size_t n)
+{
+	switch (state.kernel)
+	{
+#if HORNER_SIMD
+	case horner_kernel::ifma:
+		horner_update_ifma(state, V, n);
+		break;
+	case horner_kernel::avx2:
+		horner_update_avx2(state, V, n);
+		break;
+#endif
+	case horner_kernel::scalar:
+		if (state.ctx.montgomery)
+			horner_update_scalar<true, SCALAR_LANES>(state, V, n);
+		else
+			horner_update_scalar<false, SCALAR_LANES>(state, V, n);
+		break;
+	default:
+		if (state.ctx.montgomery)
+			horner_update_scalar<true, 1>(state, V, n);
+		else
+			horner_update_scalar<false, 1>(state, V, n);
+	}
+}
+
+IntegerWord horner_finish(const horner_state& state)
+{
+	const mod_context& ctx = state.ctx;
+	IntegerWord lanes[IFMA_LANES];
+	for (std::size_t l = 0; l < state.lanes; ++l)
+		lanes[l] = state.acc[l];
+	//Montgomery states are S_l * R^-1: R = w for the scalar chains, 2^32 and 2^52 for the SIMD ones
+	if (state.kernel == horner_kernel::ifma || state.kernel == horner_kernel::avx2)
+	{
+		unsigned radix_bits = state.kernel == horner_kernel::ifma ? 52 : 32;
+		IntegerWord radix = ((IntegerWord) 1 << radix_bits) % ctx.mod;
+		for (std::size_t l = 0; l < state.lanes; ++l)
+			lanes[l] = mul_mod(lanes[l], radix, ctx.mod);
+	}
+	else if (ctx.montgomery)
+	{
+		for (std::size_t l = 0; l < state.lanes; ++l)
+			lanes[l] = montgomery_horner_step(ctx, lanes[l], 0);
+	}
+	return horner_mod(ctx, lanes, 0, state.lanes);
+}
+
+IntegerWord horner_mod_lanes(const mod_context& ctx, const IntegerWord* V, std::size_t start, std::size_t end)
+{
+	horner_state state;
+	horner_start(state, ctx, end - start);
+	horner_update(state, V + start, end - start);
+	return horner_finish(state);
+}
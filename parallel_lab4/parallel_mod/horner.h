@@ -0,0 +1,39 @@
+#pragma once
+#include "mod_ops.h"
+
+//sum of V[i] * w^(i - start) over [start, end) mod m: Horner's rule as one dependency chain
+IntegerWord horner_mod(const mod_context& ctx, const IntegerWord* V, std::size_t start, std::size_t end);
+
+//Same value from independent Horner chains over interleaved words, merged at the end, so that the latency of
+//one chain's multiplies is hidden behind the others: AVX-512 IFMA lanes for odd m in [2^13, 2^52), AVX2 lanes
+//for odd m < 2^31 and scalar chains otherwise
+IntegerWord horner_mod_lanes(const mod_context& ctx, const IntegerWord* V, std::size_t start, std::size_t end);
+
+//Lane counts of every kernel divide this, so pieces of this many words keep the chains aligned
+constexpr std::size_t HORNER_PIECE_ALIGN = 96;
+
+enum class horner_kernel
+{
+	scalar_single,
+	scalar,
+	avx2,
+	ifma
+};
+
+//The chains of horner_mod_lanes for one modulus, fed a range piece by piece from its top down, so that several
+//moduli can take turns on the same piece while it is in cache
+struct horner_state
+{
+	mod_context ctx;
+	horner_kernel kernel;
+	std::size_t lanes;
+	IntegerWord step;            //per-row multiplier of each lane, in the kernel's representation
+	alignas(64) IntegerWord acc[32];
+};
+
+//Chooses the kernel for a range of the given length and clears the chains
+void horner_start(horner_state& state, const mod_context& ctx, std::size_t words);
+//Folds V[0, n) in below the words folded so far; every piece but the first must be a multiple of HORNER_PIECE_ALIGN
+void horner_update(horner_state& state, const IntegerWord* V, std::size_t n);
+//Value of all pieces, lowest word first
+IntegerWord horner_finish(const horner_state& state);
@@ -0,0 +1,100 @@
+#include "incremental_mod.h"
+#include "horner.h"
+#include "vector_mod.h"
+#include <algorithm>
+
+residue_tracker::residue_tracker(const IntegerWord* V, std::size_t N, IntegerWord mod)
+	: ctx(make_mod_context(mod)), length(N), residue(vector_mod(V, N, mod))
+{
+}
+
+void residue_tracker::append(const IntegerWord* words, std::size_t count)
+{
+	IntegerWord added = horner_mod_lanes(ctx, words, 0, count);
+	residue = add_mod(residue, mul_mod(added, word_pow_mod(length, ctx.mod), ctx.mod), ctx.mod);
+	length += count;
+}
+
+void residue_tracker::truncate(std::size_t new_size, const IntegerWord* removed)
+{
+	verify(new_size <= length);
+	IntegerWord dropped = mul_mod(horner_mod_lanes(ctx, removed, 0, length - new_size), word_pow_mod(new_size, ctx.mod), ctx.mod);
+	residue = add_mod(residue, dropped ? ctx.mod - dropped : 0, ctx.mod);
+	length = new_size;
+}
+
+void residue_tracker::overwrite(std::size_t position, const IntegerWord* old_words, const IntegerWord* new_words, std::size_t count)
+{
+	verify(position + count <= length);
+	IntegerWord before = horner_mod_lanes(ctx, old_words, 0, count);
+	IntegerWord after = horner_mod_lanes(ctx, new_words, 0, count);
+	IntegerWord change = add_mod(after, before ? ctx.mod - before : 0, ctx.mod);
+	residue = add_mod(residue, mul_mod(change, word_pow_mod(position, ctx.mod), ctx.mod), ctx.mod);
+}
+
+residue_tree::residue_tree(const IntegerWord* V, std::size_t N, IntegerWord mod)
+	: ctx(make_mod_context(mod)), length(N), leaves(0), words(V, V + N)
+{
+	reserve(N);
+}
+
+//Grows to a power-of-two block count holding capacity words and rebuilds every node
+void residue_tree::reserve(std::size_t capacity)
+{
+	std::size_t blocks = 1;
+	while (blocks * BLOCK_WORDS < capacity)
+		blocks *= 2;
+	if (blocks <= leaves)
+		return;
+	leaves = blocks;
+	words.resize(leaves * BLOCK_WORDS, 0);
+	nodes.assign(2 * leaves, 0);
+	powers.assign(1, word_pow_mod(BLOCK_WORDS, ctx.mod));
+	for (std::size_t span = 2; span < leaves; span *= 2)
+		powers.push_back(mul_mod(powers.back(), powers.back(), ctx.mod));
+	update(0, leaves - 1);
+}
+
+//Recomputes blocks [first_block, last_block] and their ancestors, level by level
+void residue_tree::update(std::size_t first_block, std::size_t last_block)
+{
+	for (std::size_t block = first_block; block <= last_block; ++block)
+		nodes[leaves + block] = horner_mod(ctx, words.data(), block * BLOCK_WORDS, (block + 1) * BLOCK_WORDS);
+	std::size_t first = leaves + first_block, last = leaves + last_block;
+	for (std::size_t height = 0; first > 1; ++height)
+	{
+		first /= 2;
+		last /= 2;
+		for (std::size_t node = first; node <= last; ++node)
+			nodes[node] = add_mod(nodes[2 * node], mul_mod(nodes[2 * node + 1], powers[height], ctx.mod), ctx.mod);
+	}
+}
+
+void residue_tree::overwrite(std::size_t position, const IntegerWord* new_words, std::size_t count)
+{
+	verify(position + count <= length);
+	if (!count)
+		return;
+	std::copy(new_words, new_words + count, words.begin() + position);
+	update(position / BLOCK_WORDS, (position + count - 1) / BLOCK_WORDS);
+}
+
+void residue_tree::append(const IntegerWord* new_words, std::size_t count)
+{
+	if (!count)
+		return;
+	if (length + count > leaves * BLOCK_WORDS)
+		reserve(std::max(2 * leaves * BLOCK_WORDS, length + count));
+	length += count;
+	overwrite(length - count, new_words, count);
+}
+
+void residue_tree::truncate(std::size_t new_size)
+{
+	verify(new_size <= length);
+	if (new_size == length)
+		return;
+	std::fill(words.begin() + new_size, words.begin() + length, 0);
+	update(new_size / BLOCK_WORDS, (length - 1) / BLOCK_WORDS);
+	length = new_size;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "mod_ops.h"
+#include <vector>
+
+//Residue of a vector the caller keeps, updated from the changed words alone: an update costs O(changed words) for
+//their Horner value plus O(log N) for word_pow_mod of the position they sit at
+class residue_tracker
+{
+public:
+	residue_tracker(const IntegerWord* V, std::size_t N, IntegerWord mod);
+
+	void append(const IntegerWord* words, std::size_t count);
+	//removed holds the old words [new_size, size())
+	void truncate(std::size_t new_size, const IntegerWord* removed);
+	//Words [position, position + count) change from old_words to new_words
+	void overwrite(std::size_t position, const IntegerWord* old_words, const IntegerWord* new_words, std::size_t count);
+
+	IntegerWord value() const { return residue; }
+	std::size_t size() const { return length; }
+
+private:
+	mod_context ctx;
+	std::size_t length;
+	IntegerWord residue;
+};
+
+//Own copy of the vector split into blocks of BLOCK_WORDS words under a segment tree: a node over 2^h blocks keeps
+//left + right * w^(BLOCK_WORDS * 2^(h - 1)), the root is the residue. Writing anywhere costs O(count + BLOCK_WORDS)
+//for the touched blocks plus O(log N) ancestors, with no word_pow_mod call; capacity doubles on append.
+class residue_tree
+{
+public:
+	static constexpr std::size_t BLOCK_WORDS = 64;
+
+	residue_tree(const IntegerWord* V, std::size_t N, IntegerWord mod);
+
+	void set(std::size_t position, IntegerWord word) { overwrite(position, &word, 1); }
+	void overwrite(std::size_t position, const IntegerWord* new_words, std::size_t count);
+	void append(const IntegerWord* new_words, std::size_t count);
+	void truncate(std::size_t new_size);
+	//Room for capacity words without another rebuild; append doubles the capacity when it runs out
+	void reserve(std::size_t capacity);
+
+	IntegerWord value() const { return nodes[1]; }
+	std::size_t size() const { return length; }
+	const IntegerWord* data() const { return words.data(); }
+
+private:
+	void update(std::size_t first_block, std::size_t last_block);
+
+	mod_context ctx;
+	std::size_t length;
+	std::size_t leaves;
+	std::vector<IntegerWord> words;  //leaves * BLOCK_WORDS, zero past length
+	std::vector<IntegerWord> nodes;  //heap order, root at 1, block b at leaves + b
+	std::vector<IntegerWord> powers; //w^(BLOCK_WORDS * 2^h): right-child shift for parents of height h + 1
+};
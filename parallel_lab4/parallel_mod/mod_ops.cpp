@@ -81,3 +81,64 @@ IntegerWord mul_mod(IntegerWord a, IntegerWord b, IntegerWord mod)
 	return  res_lo % mod;
 }
 #endif
+
+IntegerWord pow_mod(IntegerWord base, IntegerWord power, IntegerWord mod)
+{
+	IntegerWord result = 1 % mod;
+	while (power > 0)
+	{
+		if (power % 2 != 0)
+			result = mul_mod(result, base, mod);
+		power >>= 1;
+		base = mul_mod(base, base, mod);
+	}
+	return result;
+}
+
+IntegerWord word_pow_mod(std::size_t power, IntegerWord mod)
+{
+	return pow_mod(-mod % mod, power, mod);
+}
+
+//floor((high * w + low) / divisor) for high < divisor, by shift-and-subtract; only used to build contexts
+static IntegerWord div_wide(IntegerWord high, IntegerWord low, IntegerWord divisor)
+{
+	IntegerWord quotient = 0;
+	for (unsigned i = 0; i < WORD_BITS; ++i)
+	{
+		bool carry = high >> (WORD_BITS - 1);
+		high = high << 1 | low >> (WORD_BITS - 1);
+		low <<= 1;
+		quotient <<= 1;
+		if (carry || high >= divisor)
+		{
+			high -= divisor;
+			quotient |= 1;
+		}
+	}
+	return quotient;
+}
+
+mod_context make_mod_context(IntegerWord mod)
+{
+	mod_context ctx = {};
+	ctx.mod = mod;
+	ctx.montgomery = mod % 2 != 0;
+	ctx.word = -mod % mod;
+	if (ctx.montgomery)
+	{
+		IntegerWord inverse = mod; //m * m = 1 mod 8 for odd m, Newton steps double the correct bits
+		for (unsigned bits = 3; bits < WORD_BITS; bits *= 2)
+			inverse *= 2 - mod * inverse;
+		ctx.inverse = inverse;
+		ctx.word_sq = mul_mod(ctx.word, ctx.word, mod);
+	}
+	else
+	{
+		while (!(mod << ctx.shift >> (WORD_BITS - 1)))
+			++ctx.shift;
+		ctx.normalized = mod << ctx.shift;
+		ctx.reciprocal = div_wide(~ctx.normalized, ~(IntegerWord) 0, ctx.normalized);
+	}
+	return ctx;
+}
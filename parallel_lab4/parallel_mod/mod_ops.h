@@ -1,6 +1,114 @@
 #pragma once
 #include "config.h"
+#include <climits>
+#if defined(_MSC_VER) && INTWORD_MAX == 0xffffffffffffffffu
+#include <intrin.h>
+#endif
 
 IntegerWord add_mod(IntegerWord a, IntegerWord b, IntegerWord m); //(a + b) mod m
 IntegerWord mul_mod(IntegerWord a, IntegerWord b, IntegerWord m); //(a * b) mod m
 #define times_word(x, mod) mul_mod(x, -mod, mod) //(a * w) mod m
+IntegerWord pow_mod(IntegerWord base, IntegerWord power, IntegerWord mod); //base^power mod m
+IntegerWord word_pow_mod(std::size_t power, IntegerWord mod); //w^power mod m
+
+#define WORD_BITS (sizeof(IntegerWord) * CHAR_BIT)
+
+//Full product a * b: returns the low word, stores the high word in *high
+inline IntegerWord mul_wide(IntegerWord a, IntegerWord b, IntegerWord* high)
+{
+#if defined(__GNUC__) && INTWORD_MAX == 0xffffffffffffffffu
+	unsigned __int128 product = (unsigned __int128) a * b;
+	*high = (IntegerWord) (product >> 64);
+	return (IntegerWord) product;
+#elif INTWORD_MAX == 0xffffffffu
+	std::uint64_t product = (std::uint64_t) a * b;
+	*high = (IntegerWord) (product >> 32);
+	return (IntegerWord) product;
+#elif defined(_MSC_VER)
+	unsigned __int64 result_high;
+	IntegerWord result_low = (IntegerWord) _umul128(a, b, &result_high);
+	*high = (IntegerWord) result_high;
+	return result_low;
+#else
+	IntegerWord half_mask = (IntegerWord) -1 >> WORD_BITS / 2;
+	IntegerWord x0 = a & half_mask, x1 = a >> WORD_BITS / 2;
+	IntegerWord y0 = b & half_mask, y1 = b >> WORD_BITS / 2;
+	IntegerWord p00 = x0 * y0, p01 = x0 * y1, p10 = x1 * y0, p11 = x1 * y1;
+	IntegerWord middle = (p00 >> WORD_BITS / 2) + (p01 & half_mask) + (p10 & half_mask); //no overflow: < 3 * 2^(W/2)
+	*high = p11 + (p01 >> WORD_BITS / 2) + (p10 >> WORD_BITS / 2) + (middle >> WORD_BITS / 2);
+	return (middle << WORD_BITS / 2) | (p00 & half_mask);
+#endif
+}
+
+//Reduction constants for one modulus, built once per vector_mod call so that the per-word Horner step
+//sum * w + V[i] needs no division. Odd moduli use Montgomery reduction with R = w; even moduli use
+//division by an invariant normalized divisor with a precomputed reciprocal (Barrett style, Moller-Granlund 2-by-1).
+struct mod_context
+{
+	IntegerWord mod;
+	bool montgomery;
+	IntegerWord word;       //w mod m
+	//Montgomery (odd m)
+	IntegerWord inverse;    //m^-1 mod w
+	IntegerWord word_sq;    //w^2 mod m
+	//Barrett (even m)
+	unsigned shift;         //leading zero bits of m
+	IntegerWord normalized; //m << shift
+	IntegerWord reciprocal; //floor((w^2 - 1) / normalized) - w
+};
+
+mod_context make_mod_context(IntegerWord mod);
+
+//(high * w + low) * w^-1 mod m for odd m, requires high < m
+inline IntegerWord montgomery_reduce(const mod_context& ctx, IntegerWord high, IntegerWord low)
+{
+	IntegerWord q = low * ctx.inverse, qm_high;
+	mul_wide(q, ctx.mod, &qm_high); //low words of q * m and high * w + low are equal, so no borrow
+	IntegerWord result = high - qm_high;
+	return high < qm_high ? result + ctx.mod : result;
+}
+
+//(high * w + low) mod m, requires high < m
+inline IntegerWord barrett_reduce(const mod_context& ctx, IntegerWord high, IntegerWord low)
+{
+	IntegerWord u1 = ctx.shift ? high << ctx.shift | low >> (WORD_BITS - ctx.shift) : high;
+	IntegerWord u0 = low << ctx.shift;
+	IntegerWord q1, q0 = mul_wide(ctx.reciprocal, u1, &q1);
+	q0 += u0;
+	q1 += u1 + 1 + (q0 < u0);
+	IntegerWord r = u0 - q1 * ctx.normalized;
+	if (r > q0)
+		r += ctx.normalized;
+	if (r >= ctx.normalized)
+		r -= ctx.normalized;
+	return r >> ctx.shift;
+}
+
+//(a * b + word) * w^-1 mod m for odd m and a, b < m: the sum stays below m * w
+inline IntegerWord montgomery_mul_add(const mod_context& ctx, IntegerWord a, IntegerWord b, IntegerWord word)
+{
+	IntegerWord high, low = mul_wide(a, b, &high);
+	low += word;
+	return montgomery_reduce(ctx, high + (low < word), low);
+}
+
+//(a * b + word) mod m for a, b < m
+inline IntegerWord barrett_mul_add(const mod_context& ctx, IntegerWord a, IntegerWord b, IntegerWord word)
+{
+	IntegerWord high, low = mul_wide(a, b, &high);
+	low += word;
+	return barrett_reduce(ctx, high + (low < word), low);
+}
+
+//Montgomery Horner state for a partial sum s is s * w^-1 mod m: one step maps it to (s * w + word) * w^-1,
+//which is acc * (w^2 mod m) + word reduced. The plain value is montgomery_horner_step(ctx, acc, 0).
+inline IntegerWord montgomery_horner_step(const mod_context& ctx, IntegerWord acc, IntegerWord word)
+{
+	return montgomery_mul_add(ctx, acc, ctx.word_sq, word);
+}
+
+//Barrett Horner state is the plain partial sum: (acc * w + word) mod m as acc * (w mod m) + word reduced
+inline IntegerWord barrett_horner_step(const mod_context& ctx, IntegerWord acc, IntegerWord word)
+{
+	return barrett_mul_add(ctx, acc, ctx.word, word);
+}
@@ -4,6 +4,13 @@
 #include "num_threads.h"
 #include "randomize.h"
 #include "vector_mod.h"
+#include "file_mod.h"
+#include "incremental_mod.h"
+#include "horner.h"
+#include <cstdio>
+#include <utility>
+#include <random>
+#include <algorithm>
 
 std::vector<measurement> run_experiments()
 {
@@ -20,7 +27,193 @@ std::vector<measurement> run_experiments()
 		auto tm0 = steady_clock::now();
 		auto result = vector_mod(data.get(), word_count, divisor);
 		auto time = duration_cast<milliseconds>(steady_clock::now() - tm0);
-		results.emplace_back(measurement{result, time});
+		tm0 = steady_clock::now();
+		auto dynamic_result = vector_mod_dynamic(data.get(), word_count, divisor);
+		auto dynamic_time = duration_cast<milliseconds>(steady_clock::now() - tm0);
+		results.emplace_back(measurement{result, time, dynamic_result, dynamic_time});
 	}
 	return results;
-}
\ No newline at end of file
+}
+
+std::vector<kernel_measurement> run_kernel_experiments()
+{
+	constexpr std::size_t word_count = (std::size_t(1) << 31) / sizeof(IntegerWord);
+	//Above 2^52 (scalar chains), odd below 2^52 and 2^31 (IFMA where available, else AVX2 for the latter) and
+	//odd below 2^13 (AVX2 even with IFMA)
+	const IntegerWord moduli[] = {INTWORD_MAX, INTWORD_MAX >> 12, 0x7fffffff, 0x1fff};
+	auto data = std::make_unique<IntegerWord[]>(word_count);
+	std::vector<kernel_measurement> results;
+	randomize(data.get(), word_count * sizeof(IntegerWord));
+	set_num_threads(1);
+	for (IntegerWord modulus : moduli)
+	{
+		horner_state state;
+		horner_start(state, make_mod_context(modulus), word_count);
+		const char* kernel = state.kernel == horner_kernel::ifma ? "IFMA 32-lane" :
+			state.kernel == horner_kernel::avx2 ? "AVX2 16-lane" : "scalar 6-lane";
+		using namespace std::chrono;
+		auto tm0 = steady_clock::now();
+		auto result = vector_mod(data.get(), word_count, modulus);
+		auto time = duration_cast<milliseconds>(steady_clock::now() - tm0);
+		results.emplace_back(kernel_measurement{kernel, modulus, result, time});
+	}
+	return results;
+}
+
+std::vector<batch_measurement> run_batch_experiments()
+{
+	constexpr std::size_t word_count = (std::size_t(1) << 31) / sizeof(IntegerWord);
+	constexpr std::size_t max_moduli = 32;
+	auto data = std::make_unique<IntegerWord[]>(word_count);
+	std::vector<IntegerWord> moduli(max_moduli), residues(max_moduli);
+	std::vector<batch_measurement> results;
+	randomize(data.get(), word_count * sizeof(IntegerWord));
+	for (std::size_t j = 0; j < max_moduli; ++j)
+		moduli[j] = INTWORD_MAX - 2 * j;
+	set_num_threads(std::thread::hardware_concurrency());
+	for (std::size_t count = 1; count <= max_moduli; count *= 2)
+	{
+		using namespace std::chrono;
+		auto tm0 = steady_clock::now();
+		vector_mod_batch(data.get(), word_count, moduli.data(), count, residues.data());
+		auto time = duration_cast<milliseconds>(steady_clock::now() - tm0);
+		results.emplace_back(batch_measurement{count, time});
+	}
+	return results;
+}
+
+std::vector<file_measurement> run_file_experiments(const char* path)
+{
+	std::vector<file_measurement> results;
+	{
+		std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(path, "wb"), std::fclose);
+		if (!file)
+			return results;
+		auto chunk = std::make_unique<IntegerWord[]>(FILE_CHUNK_BYTES / sizeof(IntegerWord));
+		for (std::size_t written = 0; written < FILE_BENCHMARK_BYTES; written += FILE_CHUNK_BYTES)
+		{
+			randomize(chunk.get(), FILE_CHUNK_BYTES);
+			if (std::fwrite(chunk.get(), 1, FILE_CHUNK_BYTES, file.get()) != FILE_CHUNK_BYTES)
+				return results;
+		}
+	}
+	using file_fn = bool (*)(const char*, IntegerWord, IntegerWord*, std::size_t);
+	std::pair<const char*, file_fn> methods[] = {
+		{"read", vector_mod_file_read},
+#if FILE_MOD_POSIX
+		{"mmap", vector_mod_file_mmap},
+#endif
+	};
+	set_num_threads(std::thread::hardware_concurrency());
+	for (auto& [name, fn] : methods)
+	{
+		using namespace std::chrono;
+		IntegerWord result = 0;
+		auto tm0 = steady_clock::now();
+		if (!fn(path, INTWORD_MAX, &result, FILE_CHUNK_BYTES))
+			break;
+		auto time = duration_cast<milliseconds>(steady_clock::now() - tm0);
+		results.emplace_back(file_measurement{name, result, time});
+	}
+	std::remove(path);
+	return results;
+}
+
+std::vector<update_measurement> run_incremental_experiments()
+{
+	constexpr std::size_t word_count = (std::size_t(1) << 27) / sizeof(IntegerWord);
+	constexpr std::size_t updates = 10000, changed = 16;
+	constexpr IntegerWord divisor = INTWORD_MAX;
+	std::vector<IntegerWord> data(word_count), fresh(updates * changed);
+	randomize(data.data(), word_count * sizeof(IntegerWord));
+	randomize(fresh.data(), fresh.size() * sizeof(IntegerWord));
+	std::vector<std::size_t> positions(updates);
+	std::mt19937_64 gen(1);
+	for (auto& position : positions)
+		position = gen() % (word_count - changed);
+	set_num_threads(std::thread::hardware_concurrency());
+
+	using namespace std::chrono;
+	std::vector<update_measurement> results;
+	auto average = [&results](const char* operation, std::size_t count, auto&& body)
+	{
+		auto tm0 = steady_clock::now();
+		for (std::size_t i = 0; i < count; ++i)
+			body(i);
+		results.emplace_back(update_measurement{operation, duration<double, std::micro>(steady_clock::now() - tm0).count() / count, true});
+	};
+	auto check = [&results](IntegerWord value, const std::vector<IntegerWord>& words)
+	{
+		results.back().matches = value == vector_mod(words.data(), words.size(), divisor);
+	};
+	//Words the tree stands for; changes are replayed here after each timed run
+	std::vector<IntegerWord> tree_data(data);
+	tree_data.reserve(word_count + updates * changed);
+
+	average("full vector_mod", 5, [&](std::size_t) { vector_mod(data.data(), word_count, divisor); });
+
+	//The tracker needs the old words of every overwrite, so data is kept current as windows overlap
+	residue_tracker tracker(data.data(), word_count, divisor);
+	average("tracker overwrite 16", updates, [&](std::size_t i)
+	{
+		tracker.overwrite(positions[i], data.data() + positions[i], fresh.data() + i * changed, changed);
+		std::copy(fresh.data() + i * changed, fresh.data() + (i + 1) * changed, data.begin() + positions[i]);
+	});
+	check(tracker.value(), data);
+	average("tracker append 16", updates, [&](std::size_t i) { tracker.append(fresh.data() + i * changed, changed); });
+	std::vector<IntegerWord> appended(data);
+	appended.insert(appended.end(), fresh.begin(), fresh.end());
+	check(tracker.value(), appended);
+	average("tracker truncate 16", updates, [&](std::size_t i)
+	{
+		tracker.truncate(tracker.size() - changed, fresh.data() + (updates - 1 - i) * changed);
+	});
+	check(tracker.value(), data);
+
+	residue_tree tree(tree_data.data(), word_count, divisor);
+	tree.reserve(word_count + updates * changed);
+	average("tree set 1", updates, [&](std::size_t i) { tree.set(positions[i], fresh[i]); });
+	for (std::size_t i = 0; i < updates; ++i)
+		tree_data[positions[i]] = fresh[i];
+	check(tree.value(), tree_data);
+	average("tree overwrite 16", updates, [&](std::size_t i) { tree.overwrite(positions[i], fresh.data() + i * changed, changed); });
+	for (std::size_t i = 0; i < updates; ++i)
+		std::copy(fresh.data() + i * changed, fresh.data() + (i + 1) * changed, tree_data.begin() + positions[i]);
+	check(tree.value(), tree_data);
+	average("tree append 16", updates, [&](std::size_t i) { tree.append(fresh.data() + i * changed, changed); });
+	tree_data.insert(tree_data.end(), fresh.begin(), fresh.end());
+	check(tree.value(), tree_data);
+	average("tree truncate 16", updates, [&](std::size_t) { tree.truncate(tree.size() - changed); });
+	tree_data.resize(word_count);
+	check(tree.value(), tree_data);
+	return results;
+}
+
+std::vector<overhead_measurement> run_overhead_experiments()
+{
+	constexpr std::size_t max_bytes = std::size_t(1) << 31;
+	constexpr IntegerWord divisor = INTWORD_MAX;
+	auto data = std::make_unique<IntegerWord[]>(max_bytes / sizeof(IntegerWord));
+	randomize(data.get(), max_bytes);
+	set_num_threads(std::thread::hardware_concurrency());
+
+	std::vector<overhead_measurement> results;
+	for (std::size_t bytes = 1024; bytes <= max_bytes; bytes *= 8)
+	{
+		using namespace std::chrono;
+		std::size_t words = bytes / sizeof(IntegerWord);
+		std::size_t repeats = std::min<std::size_t>(10000, std::max<std::size_t>(1, (std::size_t(1) << 26) / bytes));
+		IntegerWord pooled = 0, spawning = 0;
+		auto tm0 = steady_clock::now();
+		for (std::size_t i = 0; i < repeats; ++i)
+			pooled = vector_mod(data.get(), words, divisor);
+		auto tm1 = steady_clock::now();
+		for (std::size_t i = 0; i < repeats; ++i)
+			spawning = vector_mod_spawning(data.get(), words, divisor);
+		auto tm2 = steady_clock::now();
+		results.emplace_back(overhead_measurement{bytes,
+			duration<double, std::micro>(tm1 - tm0).count() / repeats, duration<double, std::micro>(tm2 - tm1).count() / repeats,
+			pooled, spawning});
+	}
+	return results;
+}
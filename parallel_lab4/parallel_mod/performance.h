@@ -7,6 +7,63 @@ struct measurement
 {
 	IntegerWord result;
 	std::chrono::milliseconds time;
+	IntegerWord dynamic_result;
+	std::chrono::milliseconds dynamic_time; //vector_mod_dynamic on the same vector
 };
 
-std::vector<measurement> run_experiments();
\ No newline at end of file
+std::vector<measurement> run_experiments();
+
+struct kernel_measurement
+{
+	const char* kernel; //lane kernel horner_start picks for the modulus
+	IntegerWord modulus;
+	IntegerWord result;
+	std::chrono::milliseconds time;
+};
+
+//vector_mod on one thread over the vector of run_experiments, with a modulus for each lane kernel
+std::vector<kernel_measurement> run_kernel_experiments();
+
+struct batch_measurement
+{
+	std::size_t moduli;
+	std::chrono::milliseconds time;
+};
+
+//vector_mod_batch over the same 2 GiB vector with a growing number of moduli, all threads
+std::vector<batch_measurement> run_batch_experiments();
+
+struct file_measurement
+{
+	const char* method;
+	IntegerWord result;
+	std::chrono::milliseconds time;
+};
+
+constexpr std::size_t FILE_BENCHMARK_BYTES = std::size_t(1) << 32;
+
+//vector_mod_file over a 4 GiB file of random words, written in bounded pieces, once per file front end.
+//The file was just written, so it is read mostly from the page cache.
+std::vector<file_measurement> run_file_experiments(const char* path);
+
+struct update_measurement
+{
+	const char* operation;
+	double microseconds;
+	bool matches; //residue after the run equals vector_mod over the words it stands for
+};
+
+//Average latency of residue_tracker and residue_tree updates on a 128 MiB vector, next to a full vector_mod
+std::vector<update_measurement> run_incremental_experiments();
+
+struct overhead_measurement
+{
+	std::size_t bytes;
+	double pooled_microseconds;
+	double spawning_microseconds;
+	IntegerWord pooled_result;
+	IntegerWord spawning_result;
+};
+
+//Average vector_mod latency on the shared thread pool against threads created per call, 1 KiB to 2 GiB, all threads
+std::vector<overhead_measurement> run_overhead_experiments();
@@ -1,4 +1,5 @@
 #include "randomize.h"
+#include "../../common/thread_pool.h"
 #include <random>
 #include <chrono>
 #include <vector>
@@ -43,11 +44,5 @@ void randomize(void* pData, std::size_t cbData)
 			}while(--bytes_rest);
 		}
 	};
-	std::vector<std::thread> workers;
-	workers.reserve(T);
-	for (std::size_t t = 1; t < T; ++t)
-		workers.emplace_back(thread_fn, t);
-	thread_fn(0);
-	for (auto& thr:workers)
-		thr.join();
+	shared_thread_pool().run((unsigned) T, thread_fn);
 }
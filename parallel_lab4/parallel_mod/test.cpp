@@ -585,3 +585,17 @@ extern const test_datum test_data[test_data_count] = {
 #else
 #error "Tests are only provided for 32-bit and 64-bit words"
 #endif // INTWORD_MAX == 0xffffffffffffffffu
+
+#include "mod_ops.h"
+
+IntegerWord vector_mod_reference(const IntegerWord* V, std::size_t N, IntegerWord mod)
+{
+	IntegerWord sum = 0;
+	for (std::size_t i = N; i > 0;)
+		sum = add_mod(times_word(sum, mod), V[--i], mod);
+	return sum;
+}
+
+extern const IntegerWord extra_test_moduli[extra_test_moduli_count] = {
+	INTWORD_MAX, INTWORD_MAX - 1, INTWORD_MAX / 2 + 1, 3, 10, 0x5a5a5a5a, 0x7fffffff, 0x2001, (INTWORD_MAX >> 12) - 58
+};
@@ -16,3 +16,12 @@ extern const test_datum test_data[];
 
 constexpr std::size_t test_data_count = 10;
 
+
+//Horner's rule with add_mod and mul_mod, for moduli without stored results
+IntegerWord vector_mod_reference(const IntegerWord* V, std::size_t N, IntegerWord mod);
+
+//Moduli covering both reductions and every lane kernel: odd (Montgomery; below 2^31 and 2^52 for the SIMD lanes),
+//even (Barrett), small and top-bit-set values
+extern const IntegerWord extra_test_moduli[];
+
+constexpr std::size_t extra_test_moduli_count = 9;
@@ -0,0 +1,173 @@
+#include "vector_mod.h"
+#include "mod_ops.h"
+#include "horner.h"
+#include "num_threads.h"
+#include "../../common/thread_pool.h"
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+
+
+struct thread_range {
+    std::size_t start;
+    std::size_t end;
+};
+
+
+thread_range vector_thread_range(size_t total_elements, unsigned num_threads, unsigned thread_id) {
+    auto extra = total_elements % num_threads;
+    auto base_size = total_elements / num_threads;
+    auto start = thread_id < extra ? (base_size + 1) * thread_id : base_size * thread_id + extra;
+    auto end = start + (thread_id < extra ? base_size + 1 : base_size);
+    return { start, end };
+}
+
+
+struct partial_result_t {
+    alignas(std::hardware_destructive_interference_size) IntegerWord value;
+};
+
+
+// One static range per thread and a tree combine; run(num_threads, worker) forks and joins the team that barrier
+// synchronizes, so vector_mod and vector_mod_spawning differ only in where their threads come from
+template <class Run>
+static IntegerWord vector_mod_static(const IntegerWord* V, std::size_t N, IntegerWord mod, unsigned num_threads,
+    spin_barrier& barrier, Run&& run) {
+    std::vector<partial_result_t> partial_results(num_threads);
+    const mod_context ctx = make_mod_context(mod);
+
+    auto worker = [V, N, num_threads, mod, &ctx, &partial_results, &barrier](unsigned thread_id) {
+        auto [start, end] = vector_thread_range(N, num_threads, thread_id);
+
+        partial_results[thread_id].value = horner_mod_lanes(ctx, V, start, end);
+
+
+        for (size_t step = 1; step < num_threads; step *= 2) {
+            barrier.arrive_and_wait();
+            if (thread_id % (2 * step) == 0 && thread_id + step < num_threads) {
+                auto neighbor_range = vector_thread_range(N, num_threads, thread_id + step);
+                partial_results[thread_id].value = add_mod(
+                    partial_results[thread_id].value,
+                    mul_mod(partial_results[thread_id + step].value,
+                        word_pow_mod(neighbor_range.start - start, mod),
+                        mod),
+                    mod);
+            }
+        }
+        };
+
+
+    run(num_threads, worker);
+    return partial_results[0].value;
+}
+
+
+IntegerWord vector_mod(const IntegerWord* V, std::size_t N, IntegerWord mod) {
+    thread_pool& pool = shared_thread_pool();
+    return vector_mod_static(V, N, mod, get_num_threads(), pool.barrier(), [&pool](unsigned count, auto& worker) {
+        pool.run(count, worker);
+        });
+}
+
+
+IntegerWord vector_mod_spawning(const IntegerWord* V, std::size_t N, IntegerWord mod) {
+    unsigned num_threads = get_num_threads();
+    spin_barrier barrier;
+    barrier.reset(num_threads);
+    return vector_mod_static(V, N, mod, num_threads, barrier, [](unsigned count, auto& worker) {
+        std::vector<std::thread> threads;
+        threads.reserve(count - 1);
+        for (unsigned thread_id = 1; thread_id < count; ++thread_id) {
+            threads.emplace_back(worker, thread_id);
+        }
+        worker(0u);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        });
+}
+
+
+IntegerWord vector_mod_dynamic(const IntegerWord* V, std::size_t N, IntegerWord mod, std::size_t chunk_words) {
+    unsigned num_threads = get_num_threads();
+    const mod_context ctx = make_mod_context(mod);
+    std::size_t chunk_count = ceil_div(N, chunk_words);
+
+    // offsets[c] = w^(c * chunk_words) mod m, the weight of chunk c in the sum
+    std::vector<IntegerWord> offsets(chunk_count);
+    IntegerWord chunk_power = word_pow_mod(chunk_words, mod);
+    for (std::size_t c = 0; c < chunk_count; ++c) {
+        offsets[c] = c ? mul_mod(offsets[c - 1], chunk_power, mod) : 1 % mod;
+    }
+
+    std::atomic<std::size_t> next_chunk{0};
+    std::vector<partial_result_t> partial_results(num_threads);
+    auto worker = [V, N, mod, chunk_words, chunk_count, &ctx, &offsets, &next_chunk, &partial_results](unsigned thread_id) {
+        IntegerWord sum = 0;
+        for (std::size_t c; (c = next_chunk.fetch_add(1, std::memory_order_relaxed)) < chunk_count;) {
+            std::size_t start = c * chunk_words, end = std::min(start + chunk_words, N);
+            sum = add_mod(sum, mul_mod(horner_mod_lanes(ctx, V, start, end), offsets[c], mod), mod);
+        }
+        partial_results[thread_id].value = sum;
+        };
+
+
+    shared_thread_pool().run(num_threads, worker);
+
+    // Each chunk already carries its offset, so the thread sums add up in any order
+    IntegerWord sum = 0;
+    for (auto& partial : partial_results) {
+        sum = add_mod(sum, partial.value, mod);
+    }
+    return sum;
+}
+
+
+// Words each thread folds into every modulus before moving to the next piece: 7.5 KiB, well inside L1
+constexpr std::size_t BATCH_PIECE_WORDS = HORNER_PIECE_ALIGN * 10;
+
+
+void vector_mod_batch(const IntegerWord* V, std::size_t N, const IntegerWord* mods, std::size_t count, IntegerWord* results) {
+    unsigned num_threads = get_num_threads();
+    std::vector<mod_context> contexts;
+    contexts.reserve(count);
+    for (std::size_t j = 0; j < count; ++j) {
+        contexts.push_back(make_mod_context(mods[j]));
+    }
+    std::vector<IntegerWord> partial_results(num_threads * count);
+
+    auto worker = [V, N, num_threads, count, &contexts, &partial_results](unsigned thread_id) {
+        auto [start, end] = vector_thread_range(N, num_threads, thread_id);
+
+        std::vector<horner_state> states(count);
+        for (std::size_t j = 0; j < count; ++j) {
+            horner_start(states[j], contexts[j], end - start);
+        }
+        // Pieces go from the top of the range down; only the first one may be shorter
+        std::size_t piece = (end - start + BATCH_PIECE_WORDS - 1) % BATCH_PIECE_WORDS + 1;
+        for (std::size_t piece_end = end; piece_end > start; piece_end -= piece, piece = BATCH_PIECE_WORDS) {
+            for (auto& state : states) {
+                horner_update(state, V + piece_end - piece, piece);
+            }
+        }
+        for (std::size_t j = 0; j < count; ++j) {
+            partial_results[thread_id * count + j] = horner_finish(states[j]);
+        }
+        };
+
+
+    shared_thread_pool().run(num_threads, worker);
+
+    // V mod m = sum of the thread results times w^start, as Horner's rule from the last thread down
+    for (std::size_t j = 0; j < count; ++j) {
+        IntegerWord mod = mods[j], sum = 0;
+        for (unsigned thread_id = num_threads; thread_id > 0;) {
+            --thread_id;
+            auto [start, end] = vector_thread_range(N, num_threads, thread_id);
+            sum = add_mod(mul_mod(sum, word_pow_mod(end - start, mod), mod), partial_results[thread_id * count + j], mod);
+        }
+        results[j] = sum;
+    }
+}
@@ -2,3 +2,14 @@
 #include "config.h"
 
 IntegerWord vector_mod(const IntegerWord* V, std::size_t N, IntegerWord mod);
+//vector_mod with threads created and joined by every call instead of taken from the shared pool: the baseline of
+//the thread pool benchmark
+IntegerWord vector_mod_spawning(const IntegerWord* V, std::size_t N, IntegerWord mod);
+
+//Words per chunk claimed by a thread in vector_mod_dynamic: 512 KiB, thousands of chunks for a 2 GiB vector
+constexpr std::size_t DYNAMIC_CHUNK_WORDS = std::size_t(1) << 16;
+//Same value as vector_mod, with threads claiming fixed-size chunks from a shared counter instead of one static
+//range each, so that slower or busier cores take fewer chunks
+IntegerWord vector_mod_dynamic(const IntegerWord* V, std::size_t N, IntegerWord mod, std::size_t chunk_words = DYNAMIC_CHUNK_WORDS);
+//results[j] = V mod mods[j] for j < count, from one pass over V
+void vector_mod_batch(const IntegerWord* V, std::size_t N, const IntegerWord* mods, std::size_t count, IntegerWord* results);
@@ -1,14 +1,20 @@
-﻿#include <barrier>
+﻿#include <algorithm>
 #include <bit>
 #include <chrono>
 #include <complex>
 #include <fstream>
+#include <immintrin.h>
 #include <iomanip>
 #include <iostream>
 #include <numbers>
 #include <random>
+#include <string>
 #include <thread>
 #include <vector>
+#include "../common/aligned_buffer.h"
+#include "../common/cpu_dispatch.h"
+#include "../common/thread_pool.h"
+#include "../common/tlb_counter.h"
 
 static unsigned nibble[16] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
 
@@ -48,17 +54,150 @@ thread_range thread_task_range(std::size_t task_count, std::size_t thread_count,
     return { start, end };
 }
 
-void fft_nonrec_multithreaded_core(const std::complex<double>* inp, std::complex<double>* out, std::size_t n, int inverse, std::size_t thread_count) {
+// One group of butterflies: lo[i], hi[i] <- lo[i] + w[i] * hi[i], lo[i] - w[i] * hi[i]
+typedef void (*butterfly_fn)(std::complex<double>* lo, std::complex<double>* hi, const std::complex<double>* w, std::size_t count);
+
+void butterflies_scalar(std::complex<double>* lo, std::complex<double>* hi, const std::complex<double>* w, std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+        auto r1 = lo[i];
+        auto r2 = w[i] * hi[i];
+        lo[i] = r1 + r2;
+        hi[i] = r1 - r2;
+    }
+}
+
+TARGET_SSE2 void butterflies_sse2(std::complex<double>* lo, std::complex<double>* hi, const std::complex<double>* w, std::size_t count) {
+    double* l = reinterpret_cast<double*>(lo);
+    double* h = reinterpret_cast<double*>(hi);
+    const double* t = reinterpret_cast<const double*>(w);
+    const __m128d negate_real = _mm_set_pd(0.0, -0.0);
+    for (std::size_t i = 0; i < count; i++) {
+        __m128d a = _mm_loadu_pd(h + 2 * i);
+        __m128d b = _mm_loadu_pd(t + 2 * i);
+        __m128d a_swapped = _mm_shuffle_pd(a, a, 1);
+        __m128d cross = _mm_xor_pd(_mm_mul_pd(a_swapped, _mm_unpackhi_pd(b, b)), negate_real);
+        __m128d r2 = _mm_add_pd(_mm_mul_pd(a, _mm_unpacklo_pd(b, b)), cross);
+        __m128d r1 = _mm_loadu_pd(l + 2 * i);
+        _mm_storeu_pd(l + 2 * i, _mm_add_pd(r1, r2));
+        _mm_storeu_pd(h + 2 * i, _mm_sub_pd(r1, r2));
+    }
+}
+
+TARGET_AVX2 void butterflies_avx2(std::complex<double>* lo, std::complex<double>* hi, const std::complex<double>* w, std::size_t count) {
+    double* l = reinterpret_cast<double*>(lo);
+    double* h = reinterpret_cast<double*>(hi);
+    const double* t = reinterpret_cast<const double*>(w);
+    std::size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m256d a = _mm256_loadu_pd(h + 2 * i);
+        __m256d b = _mm256_loadu_pd(t + 2 * i);
+        __m256d cross = _mm256_mul_pd(_mm256_permute_pd(a, 0x5), _mm256_permute_pd(b, 0xF));
+        __m256d r2 = _mm256_fmaddsub_pd(a, _mm256_movedup_pd(b), cross);
+        __m256d r1 = _mm256_loadu_pd(l + 2 * i);
+        _mm256_storeu_pd(l + 2 * i, _mm256_add_pd(r1, r2));
+        _mm256_storeu_pd(h + 2 * i, _mm256_sub_pd(r1, r2));
+    }
+    butterflies_scalar(lo + i, hi + i, w + i, count - i);
+}
+
+// butterflies_avx2 with aligned loads and stores: lo, hi and w must be 32-byte aligned whenever count >= 2,
+// which holds for aligned_vector buffers and the twiddle layout below
+TARGET_AVX2 void butterflies_avx2_aligned(std::complex<double>* lo, std::complex<double>* hi, const std::complex<double>* w, std::size_t count) {
+    double* l = reinterpret_cast<double*>(lo);
+    double* h = reinterpret_cast<double*>(hi);
+    const double* t = reinterpret_cast<const double*>(w);
+    std::size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m256d a = _mm256_load_pd(h + 2 * i);
+        __m256d b = _mm256_load_pd(t + 2 * i);
+        __m256d cross = _mm256_mul_pd(_mm256_permute_pd(a, 0x5), _mm256_permute_pd(b, 0xF));
+        __m256d r2 = _mm256_fmaddsub_pd(a, _mm256_movedup_pd(b), cross);
+        __m256d r1 = _mm256_load_pd(l + 2 * i);
+        _mm256_store_pd(l + 2 * i, _mm256_add_pd(r1, r2));
+        _mm256_store_pd(h + 2 * i, _mm256_sub_pd(r1, r2));
+    }
+    butterflies_scalar(lo + i, hi + i, w + i, count - i);
+}
+
+TARGET_AVX512 void butterflies_avx512(std::complex<double>* lo, std::complex<double>* hi, const std::complex<double>* w, std::size_t count) {
+    double* l = reinterpret_cast<double*>(lo);
+    double* h = reinterpret_cast<double*>(hi);
+    const double* t = reinterpret_cast<const double*>(w);
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m512d a = _mm512_loadu_pd(h + 2 * i);
+        __m512d b = _mm512_loadu_pd(t + 2 * i);
+        // Full-mask forms of permute and movedup: the same instructions, without the undefined source operand GCC
+        // reports as -Wmaybe-uninitialized
+        __m512d cross = _mm512_mul_pd(_mm512_mask_permute_pd(a, 0xFF, a, 0x55), _mm512_mask_permute_pd(b, 0xFF, b, 0xFF));
+        __m512d r2 = _mm512_fmaddsub_pd(a, _mm512_mask_movedup_pd(b, 0xFF, b), cross);
+        __m512d r1 = _mm512_loadu_pd(l + 2 * i);
+        _mm512_storeu_pd(l + 2 * i, _mm512_add_pd(r1, r2));
+        _mm512_storeu_pd(h + 2 * i, _mm512_sub_pd(r1, r2));
+    }
+    butterflies_avx2(lo + i, hi + i, w + i, count - i);
+}
+
+butterfly_fn select_butterflies(simd_level level) {
+    switch (level) {
+    case simd_level::avx512: return butterflies_avx512;
+    case simd_level::avx2: return butterflies_avx2;
+    case simd_level::sse2: return butterflies_sse2;
+    default: return butterflies_scalar;
+    }
+}
+
+// Bound once at startup to the widest level the CPU (and SIMD_LEVEL) allows
+const simd_level SIMD = selected_simd_level();
+const butterfly_fn butterflies_best = select_butterflies(SIMD);
+
+void fft_nonrec_multithreaded_core(const std::complex<double>* inp, std::complex<double>* out, std::size_t n, int inverse, std::size_t thread_count, butterfly_fn butterflies) {
+    bit_shuffle(inp, out, n);
+    thread_pool& pool = shared_thread_pool();
+    spin_barrier& sync_point = pool.barrier();
+
+    // Twiddles of the stage with groups of length L are stored contiguously from index L / 2 (index 0 is unused),
+    // so every stage with L >= 4 starts on a 32-byte boundary
+    aligned_vector<std::complex<double>> twiddles(n);
+
+    auto worker = [&out, n, inverse, thread_count, &sync_point, &twiddles, butterflies](std::size_t thread_id) {
+        auto [first, last] = thread_task_range(twiddles.size(), thread_count, thread_id);
+        for (std::size_t j = std::max<std::size_t>(first, 1); j < last; j++) {
+            std::size_t group_length = std::bit_floor(j) * 2;
+            std::size_t i = j - group_length / 2;
+            twiddles[j] = std::polar(1.0, -2 * std::numbers::pi_v<double> *i * inverse / group_length);
+        }
+        sync_point.arrive_and_wait();
+
+        for (std::size_t group_length = 2; group_length <= n; group_length <<= 1) {
+            auto [start, end] = thread_task_range(n / group_length, thread_count, thread_id);
+            const std::complex<double>* w = twiddles.data() + group_length / 2;
+
+            for (std::size_t group = start; group < end; group++) {
+                butterflies(out + group_length * group, out + group_length * group + group_length / 2, w, group_length / 2);
+            }
+
+            sync_point.arrive_and_wait();
+        }
+        };
+
+    pool.run(static_cast<unsigned>(thread_count), worker);
+}
+
+// The transform before the twiddle table: every butterfly computes its own twiddle with std::polar. Kept to time the
+// table separately from the SIMD butterflies that use it
+void fft_nonrec_polar(const std::complex<double>* inp, std::complex<double>* out, std::size_t n, std::size_t thread_count) {
     bit_shuffle(inp, out, n);
-    std::barrier<> sync_point(thread_count);
+    thread_pool& pool = shared_thread_pool();
+    spin_barrier& sync_point = pool.barrier();
 
-    auto worker = [&out, n, inverse, thread_count, &sync_point](std::size_t thread_id) {
+    auto worker = [&out, n, thread_count, &sync_point](std::size_t thread_id) {
         for (std::size_t group_length = 2; group_length <= n; group_length <<= 1) {
             auto [start, end] = thread_task_range(n / group_length, thread_count, thread_id);
 
             for (std::size_t group = start; group < end; group++) {
                 for (std::size_t i = 0; i < group_length / 2; i++) {
-                    auto w = std::polar(1.0, -2 * std::numbers::pi_v<double> *i * inverse / group_length);
+                    auto w = std::polar(1.0, -2 * std::numbers::pi_v<double> *i / group_length);
                     auto r1 = out[group_length * group + i];
                     auto r2 = out[group_length * group + i + group_length / 2];
                     out[group_length * group + i] = r1 + w * r2;
@@ -70,23 +209,15 @@ void fft_nonrec_multithreaded_core(const std::complex<double>* inp, std::complex
         }
         };
 
-    std::vector<std::thread> threads(thread_count - 1);
-    for (std::size_t i = 1; i < thread_count; i++) {
-        threads[i - 1] = std::thread(worker, i);
-    }
-    worker(0);
-
-    for (auto& t : threads) {
-        t.join();
-    }
+    pool.run(static_cast<unsigned>(thread_count), worker);
 }
 
-void fft_nonrec_multithreaded(const std::complex<double>* inp, std::complex<double>* out, std::size_t n, std::size_t thread_count) {
-    fft_nonrec_multithreaded_core(inp, out, n, 1, thread_count);
+void fft_nonrec_multithreaded(const std::complex<double>* inp, std::complex<double>* out, std::size_t n, std::size_t thread_count, butterfly_fn butterflies = butterflies_best) {
+    fft_nonrec_multithreaded_core(inp, out, n, 1, thread_count, butterflies);
 }
 
-void ifft_nonrec_multithreaded(const std::complex<double>* inp, std::complex<double>* out, std::size_t n, std::size_t thread_count) {
-    fft_nonrec_multithreaded_core(inp, out, n, -1, thread_count);
+void ifft_nonrec_multithreaded(const std::complex<double>* inp, std::complex<double>* out, std::size_t n, std::size_t thread_count, butterfly_fn butterflies = butterflies_best) {
+    fft_nonrec_multithreaded_core(inp, out, n, -1, thread_count, butterflies);
     for (std::size_t i = 0; i < n; i++) {
         out[i] /= static_cast<std::complex<double>>(n);
     }
@@ -119,6 +250,32 @@ int main() {
         std::cerr << "Error opening output file!\n";
         return 1;
     }
+    // Every variant the CPU supports must invert its own transform, whatever SIMD_LEVEL selects
+    simd_level detected = detect_simd_level();
+    std::vector<simd_level> levels;
+    for (simd_level level : { simd_level::scalar, simd_level::sse2, simd_level::avx2, simd_level::avx512 }) {
+        if (level <= detected) {
+            levels.push_back(level);
+        }
+    }
+
+    randomize_vector(original);
+    for (simd_level level : levels) {
+        fft_nonrec_multithreaded(original.data(), spectre.data(), n, std::thread::hardware_concurrency(), select_butterflies(level));
+        ifft_nonrec_multithreaded(spectre.data(), restored.data(), n, std::thread::hardware_concurrency(), select_butterflies(level));
+        if (!approx_equal(original, restored)) {
+            std::cerr << "correct test failed for " << simd_level_name(level) << "\n";
+            return 1;
+        }
+    }
+    fft_nonrec_multithreaded(original.data(), spectre.data(), n, std::thread::hardware_concurrency(), butterflies_scalar);
+    fft_nonrec_polar(original.data(), restored.data(), n, std::thread::hardware_concurrency());
+    if (!approx_equal(spectre, restored)) {
+        std::cerr << "correct test failed for on-the-fly twiddles\n";
+        return 1;
+    }
+    std::cout << "correct test passed, detected " << simd_level_name(detected) << ", bound " << simd_level_name(SIMD) << "\n";
+
     output << "T,Duration,Speedup\n";
 
     double base_time = 0; // Для времени выполнения с одним потоком
@@ -144,6 +301,92 @@ int main() {
         output << i << "," << average_time << "," << speedup << "\n";
     }
 
+    // The twiddle table on its own: scalar butterflies computing each twiddle with std::polar, against the same
+    // butterflies reading the table (the scalar row below)
+    double polar_time = 0;
+    for (std::size_t j = 0; j < exp_count; j++) {
+        randomize_vector(original);
+        auto start = std::chrono::steady_clock::now();
+        fft_nonrec_polar(original.data(), spectre.data(), n, std::thread::hardware_concurrency());
+        auto end = std::chrono::steady_clock::now();
+        polar_time += std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    }
+    polar_time /= exp_count;
+    std::cout << "FFT scalar, on-the-fly twiddles: Threads = " << std::thread::hardware_concurrency() << ", Avg. Duration = " << polar_time << " ms\n";
+    output << "on-the-fly twiddles," << polar_time << ",1.0\n";
+
+    // Each variant with all threads on the twiddle table, relative to the scalar butterflies
+    double scalar_time = 0;
+    for (simd_level level : levels) {
+        double total_time = 0;
+        for (std::size_t j = 0; j < exp_count; j++) {
+            randomize_vector(original);
+            auto start = std::chrono::steady_clock::now();
+            fft_nonrec_multithreaded(original.data(), spectre.data(), n, std::thread::hardware_concurrency(), select_butterflies(level));
+            auto end = std::chrono::steady_clock::now();
+            total_time += std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        }
+
+        double average_time = total_time / exp_count;
+        if (level == simd_level::scalar) {
+            scalar_time = average_time;
+        }
+        std::cout << "FFT " << simd_level_name(level) << ": Threads = " << std::thread::hardware_concurrency() << ", Avg. Duration = " << average_time
+            << " ms, Speedup = " << scalar_time / average_time;
+        if (level == simd_level::scalar) {
+            std::cout << " (twiddle table speedup = " << polar_time / average_time << ")";
+        }
+        std::cout << "\n";
+        output << simd_level_name(level) << "," << average_time << "," << scalar_time / average_time << "\n";
+    }
+
+    // Aligned AVX2 butterflies on aligned_vector buffers with each page mode, against the unaligned
+    // kernel on std::vector. dTLB misses are counted where perf events are available.
+    if (SIMD >= simd_level::avx2) {
+        tlb_miss_counter tlb_counter;
+        auto misses_text = [](long long misses) { return misses < 0 ? std::string("n/a") : std::to_string(misses / static_cast<long long>(exp_count)); };
+        auto measure = [&](const std::complex<double>* inp, std::complex<double>* out, butterfly_fn butterflies, long long& misses) {
+            double total_time = 0;
+            tlb_counter.start();
+            for (std::size_t j = 0; j < exp_count; j++) {
+                auto start = std::chrono::steady_clock::now();
+                fft_nonrec_multithreaded(inp, out, n, std::thread::hardware_concurrency(), butterflies);
+                auto end = std::chrono::steady_clock::now();
+                total_time += std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+            }
+            misses = tlb_counter.stop();
+            return total_time / exp_count;
+            };
+
+        randomize_vector(original);
+        long long vector_misses = 0;
+        double vector_time = measure(original.data(), spectre.data(), butterflies_avx2, vector_misses);
+        std::cout << "FFT AVX2, std::vector: Avg. Duration = " << vector_time << " ms, dTLB misses = " << misses_text(vector_misses) << "\n";
+        output << "std::vector," << vector_time << ",1.0\n";
+
+        for (page_mode mode : { page_mode::normal, page_mode::transparent_huge, page_mode::explicit_huge }) {
+            aligned_allocator<std::complex<double>> allocator(mode);
+            aligned_vector<std::complex<double>> aligned_original(original.begin(), original.end(), allocator), aligned_spectre(n, allocator);
+            // A mode that fell back (no huge page pool, or no THP on Windows) would only repeat an earlier row
+            if (buffer_page_mode(aligned_original.data()) != mode || buffer_page_mode(aligned_spectre.data()) != mode) {
+                std::cout << "FFT aligned AVX2, " << page_mode_name(mode) << ": unavailable, skipped\n";
+                continue;
+            }
+            long long aligned_misses = 0;
+            double aligned_time = measure(aligned_original.data(), aligned_spectre.data(), butterflies_avx2_aligned, aligned_misses);
+            for (std::size_t i = 0; i < n; i++) {
+                if (std::abs(aligned_spectre[i] - spectre[i]) > 0.0001) {
+                    std::cerr << "aligned FFT test failed\n";
+                    return 1;
+                }
+            }
+
+            const char* mode_name = page_mode_name(buffer_page_mode(aligned_spectre.data()));
+            std::cout << "FFT aligned AVX2, " << mode_name << ": Avg. Duration = " << aligned_time << " ms, Speedup = " << vector_time / aligned_time
+                << ", dTLB misses = " << misses_text(aligned_misses) << "\n";
+            output << "aligned " << mode_name << "," << aligned_time << "," << vector_time / aligned_time << "\n";
+        }
+    }
 
     output.close();
     return 0;